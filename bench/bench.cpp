@@ -0,0 +1,446 @@
+// Timings of the hot paths of the solver, run by hand from the build directory: ./bench [section...]
+// The sections are parse, storage, scan, split, ls, repair, ma and threads, all of them by default. Every timing
+// repeats its call until a fraction of a second has passed, the instances are read from the data directory without
+// the binary cache, except in the "cached" column of parse.
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <filesystem>
+#include <chrono>
+#include <random>
+#include <map>
+#include <cfloat>
+
+#include "../include/case.hpp"
+#include "../include/evaluator.hpp"
+#include "../include/individual.hpp"
+#include "../include/instance_cache.hpp"
+#include "../include/station_scan.hpp"
+#include "../include/utils.hpp"
+#include "../include/MA.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+using Clock = chrono::steady_clock;
+
+static volatile double sink; // keeps the timed loops from being optimized away
+
+static string data_file(const string& name) {
+    return string(CEVRP_DATA_DIR) + name + ".evrp";
+}
+
+static double seconds_since(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// seconds per call of "body", over as many calls as fit in "budget" seconds (at least one)
+template <typename Body>
+static double time_per_call(const Body& body, double budget = 0.3) {
+    long long calls = 0;
+    auto start = Clock::now();
+    do {
+        body();
+        calls++;
+    } while (seconds_since(start) < budget);
+    return seconds_since(start) / static_cast<double>(calls);
+}
+
+// the instances are loaded once and shared by the sections
+static shared_ptr<const Case> load(const string& name, int granularK = Case::DEFAULT_GRANULAR_K) {
+    static map<pair<string, int>, shared_ptr<const Case>> loaded;
+    auto& instance = loaded[{name, granularK}];
+    if (instance == nullptr) instance = make_shared<const Case>(data_file(name), DistanceStorage::FULL_DOUBLE, false, granularK);
+    return instance;
+}
+
+// "count" random giant tours {depot, customers...}, the same ones for every call with the same instance
+static vector<vector<int>> giant_tours(const Case& instance, int count) {
+    std::default_random_engine rng(1);
+    vector<vector<int>> tours(count);
+    for (auto& tour : tours) {
+        vector<int> customers = instance.customers;
+        shuffle(customers.begin(), customers.end(), rng);
+        tour.assign(1, instance.depot);
+        tour.insert(tour.end(), customers.begin(), customers.end());
+    }
+    return tours;
+}
+
+// the individuals of "count" random giant tours, split by LINEAR
+static vector<Individual> split_individuals(const shared_ptr<const Case>& instance, int count) {
+    Evaluator evaluator(instance);
+    vector<Individual> individuals;
+    for (const auto& tour : giant_tours(*instance, count)) {
+        individuals.emplace_back(instance->vehicleNumber * 3, instance->maxRouteLength);
+        decode_giant_tour(SplitMethod::LINEAR, tour, *instance, evaluator, individuals.back());
+    }
+    return individuals;
+}
+
+static void header(const string& title) {
+    cout << "\n== " << title << "\n" << fixed;
+}
+
+// user-004, user-006: the parser alone, the whole startup from the text file, and the startup from the binary cache
+static void bench_parse() {
+    header("parse: one load per instance, ms");
+    cout << setw(14) << "instance" << setw(7) << "nodes" << setw(10) << "parse" << setw(9) << "MB/s" << setw(11) << "startup" << setw(10) << "cached" << "\n";
+    vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(CEVRP_DATA_DIR)) {
+        if (entry.path().extension() == ".evrp") files.push_back(entry.path());
+    }
+    sort(files.begin(), files.end());
+    for (const auto& file : files) {
+        Case instance(file.string(), DistanceStorage::FULL_DOUBLE, false);
+        double parse = time_per_call([&] { instance.read_problem(file.string()); });
+        const string cachePath = InstanceCache::cache_path(file.string());
+        const bool hadCache = fs::exists(cachePath);
+        Case(file.string(), DistanceStorage::FULL_DOUBLE, true); // writes the cache when there is none
+        double cached = Case(file.string(), DistanceStorage::FULL_DOUBLE, true).preprocessingTime;
+        if (!hadCache) fs::remove(cachePath);
+        cout << setw(14) << instance.instanceName << setw(7) << instance.actualProblemSize << setprecision(3)
+             << setw(10) << parse * 1e3 << setprecision(0) << setw(9) << static_cast<double>(fs::file_size(file)) / parse / 1e6
+             << setprecision(2) << setw(11) << instance.preprocessingTime * 1e3 << setw(10) << cached * 1e3 << "\n";
+    }
+
+    // a synthetic instance of a million lines, parsed into an instance read before so that only the parser is timed
+    // (a Case of that size would build quadratic tables); the plain read of the same file is the disk speed to match
+    const int customers = 500000, stations = 1000;
+    const fs::path synthetic = fs::temp_directory_path() / "cevrp-bench-synthetic.evrp";
+    {
+        ofstream out(synthetic);
+        out << "Name: synthetic\nVEHICLES: 10000\nDIMENSION: " << customers + 1 << "\nSTATIONS: " << stations
+            << "\nCAPACITY: 100\nENERGY_CAPACITY: 100000\nENERGY_CONSUMPTION: 1.00\nEDGE_WEIGHT_FORMAT: EUC_2D\nNODE_COORD_SECTION\n";
+        std::default_random_engine rng(1);
+        uniform_int_distribution<int> coordinate(0, 100000);
+        for (int i = 1; i <= customers + 1 + stations; ++i) out << i << " " << coordinate(rng) << " " << coordinate(rng) << "\n";
+        out << "DEMAND_SECTION\n";
+        for (int i = 1; i <= customers + 1; ++i) out << i << " " << (i == 1 ? 0 : 1 + i % 20) << "\n";
+        out << "STATIONS_COORD_SECTION\n";
+        for (int i = customers + 2; i <= customers + 1 + stations; ++i) out << i << "\n";
+        out << "DEPOT_SECTION\n1\n-1\nEOF\n";
+    }
+    const double megabytes = static_cast<double>(fs::file_size(synthetic)) / 1e6;
+    Case instance(data_file("E-n22-k4"), DistanceStorage::FULL_DOUBLE, false);
+    double parse = time_per_call([&] { instance.read_problem(synthetic.string()); }, 2.0);
+    string contents(fs::file_size(synthetic), '\0');
+    double read = time_per_call([&] {
+        ifstream in(synthetic, ios::binary);
+        in.read(contents.data(), static_cast<streamsize>(contents.size()));
+    }, 2.0);
+    fs::remove(synthetic);
+    cout << setw(14) << "synthetic" << setw(7) << instance.actualProblemSize << setprecision(3) << setw(10) << parse * 1e3
+         << setprecision(0) << setw(9) << megabytes / parse << "   plain read " << setprecision(0) << megabytes / read << " MB/s, "
+         << setprecision(1) << megabytes << " MB\n";
+}
+
+// user-001, user-002: memory and lookup cost of each distance storage
+static void bench_storage() {
+    header("storage: ns per lookup, random pairs and along a giant tour");
+    const char* names[] = {"full double", "full float", "packed", "on the fly"};
+    for (const string name : {"X-n916-k207", "X-n1001-k43"}) {
+        cout << name << "\n" << setw(14) << "storage" << setw(12) << "MB" << setw(10) << "random" << setw(10) << "tour" << "\n";
+        vector<int> tour = giant_tours(*load(name), 1)[0];
+        std::default_random_engine rng(1);
+        vector<pair<int, int>> pairs(1 << 20);
+        uniform_int_distribution<int> node(0, load(name)->actualProblemSize - 1);
+        for (auto& p : pairs) p = {node(rng), node(rng)};
+        for (int storage = 0; storage <= static_cast<int>(DistanceStorage::ON_THE_FLY); ++storage) {
+            Case instance(data_file(name), static_cast<DistanceStorage>(storage), false);
+            double random = time_per_call([&] {
+                double sum = 0;
+                for (const auto& p : pairs) sum += instance.distances(p.first, p.second);
+                sink = sum;
+            }) / static_cast<double>(pairs.size());
+            double walk = time_per_call([&] {
+                double sum = 0;
+                for (size_t i = 1; i < tour.size(); ++i) sum += instance.distances(tour[i - 1], tour[i]);
+                sink = sum;
+            }) / static_cast<double>(tour.size() - 1);
+            cout << setw(14) << names[storage] << setprecision(2) << setw(12) << static_cast<double>(instance.distances.memory_usage()) / 1e6
+                 << setw(10) << random * 1e9 << setw(10) << walk * 1e9 << "\n";
+        }
+    }
+}
+
+// the loop of station_scan without AVX, the reference of the synthetic slices
+static int scalar_station_scan(const StationScan& scan) {
+    double best = DBL_MAX;
+    int slot = -1;
+    for (int s = 0; s < scan.count; ++s) {
+        double key = scan.keyIncludesA ? scan.a[s] + scan.b[s] : scan.b[s];
+        if (key < best && scan.a[s] < scan.limitA && scan.b[s] < scan.limitB && s != scan.skip1 && s != scan.skip2) {
+            best = key;
+            slot = s;
+        }
+    }
+    return slot;
+}
+
+// user-017: the station scans over random customer pairs, then over synthetic slices of 8 to 128 stations
+static void bench_scan() {
+    header(string("scan: ns per call, ") + station_scan_isa());
+    cout << setw(14) << "instance" << setw(10) << "stations" << setw(8) << "best" << setw(10) << "nearest" << "\n";
+    for (const string name : {"E-n22-k4", "E-n101-k8", "X-n214-k11", "X-n573-k30", "X-n1001-k43"}) {
+        auto instance = load(name);
+        std::default_random_engine rng(1);
+        vector<pair<int, int>> pairs(1 << 14);
+        uniform_int_distribution<size_t> customer(0, instance->customers.size() - 1);
+        for (auto& p : pairs) p = {instance->customers[customer(rng)], instance->customers[customer(rng)]};
+        double best = time_per_call([&] {
+            int sum = 0;
+            for (const auto& p : pairs) sum += instance->find_best_station(p.first, p.second);
+            sink = sum;
+        }) / static_cast<double>(pairs.size());
+        double nearest = time_per_call([&] {
+            int sum = 0;
+            for (const auto& p : pairs) sum += instance->find_nearest_station_to_y_feasible(p.first, p.second, instance->maxDis);
+            sink = sum;
+        }) / static_cast<double>(pairs.size());
+        cout << setw(14) << name << setw(10) << instance->stationNumber << setprecision(1) << setw(8) << best * 1e9 << setw(10) << nearest * 1e9 << "\n";
+    }
+
+    // every instance has fewer stations than the AVX threshold (24), so the scan is also timed on synthetic slices of
+    // random distances, against the plain scalar loop that it must match
+    header(string("scan: ns per call on synthetic slices, ") + station_scan_isa() + " against the scalar loop");
+    cout << setw(10) << "stations" << setw(10) << "scan" << setw(10) << "scalar" << setw(10) << "speedup" << "\n";
+    for (int count : {8, 16, 24, 32, 64, 128}) {
+        const int rows = 1024;
+        std::default_random_engine rng(1);
+        uniform_real_distribution<double> distance(0.0, 100.0);
+        vector<double> slice(static_cast<size_t>(rows) * count);
+        for (auto& value : slice) value = distance(rng);
+        vector<StationScan> scans(rows);
+        for (int r = 0; r < rows; ++r) {
+            const int other = (r * 7 + 1) % rows;
+            scans[r] = {slice.data() + static_cast<size_t>(r) * count, slice.data() + static_cast<size_t>(other) * count, count, r % 2 == 0, 80.0, 80.0, r % count, -1};
+        }
+        for (const auto& scan : scans) {
+            if (station_scan(scan) != scalar_station_scan(scan)) throw runtime_error("station_scan differs from the scalar loop");
+        }
+        double scan = time_per_call([&] {
+            int sum = 0;
+            for (const auto& one : scans) sum += station_scan(one);
+            sink = sum;
+        }) / rows;
+        double scalar = time_per_call([&] {
+            int sum = 0;
+            for (const auto& one : scans) sum += scalar_station_scan(one);
+            sink = sum;
+        }) / rows;
+        cout << setw(10) << count << setprecision(1) << setw(10) << scan * 1e9 << setw(10) << scalar * 1e9 << setprecision(2) << setw(10) << scalar / scan << "\n";
+    }
+}
+
+// user-024: the split methods on random giant tours
+static void bench_split() {
+    header("split: ms per giant tour, mean length of the routes");
+    const pair<string, SplitMethod> methods[] = {{"prins", SplitMethod::PRINS}, {"linear", SplitMethod::LINEAR},
+                                                 {"linear soft", SplitMethod::LINEAR_SOFT}, {"energy", SplitMethod::ENERGY}};
+    for (const string name : {"E-n101-k8", "X-n916-k207", "X-n1001-k43"}) {
+        auto instance = load(name);
+        vector<vector<int>> tours = giant_tours(*instance, 10);
+        Individual individual(instance->vehicleNumber * 3, instance->maxRouteLength);
+        cout << name << "\n";
+        for (const auto& [label, method] : methods) {
+            Evaluator evaluator(instance);
+            size_t next = 0;
+            double split = time_per_call([&] {
+                sink = static_cast<double>(split_giant_tour(method, tours[next++ % tours.size()], *instance, evaluator).size());
+            });
+            next = 0;
+            double decode = time_per_call([&] {
+                decode_giant_tour(method, tours[next++ % tours.size()], *instance, evaluator, individual);
+            });
+            double length = 0;
+            for (const auto& tour : tours) {
+                decode_giant_tour(method, tour, *instance, evaluator, individual);
+                length += individual.get_fit() / static_cast<double>(tours.size());
+            }
+            cout << setw(14) << label << setprecision(3) << setw(10) << split * 1e3 << " (decode " << decode * 1e3 << ")"
+                 << setprecision(1) << setw(12) << length << "\n";
+        }
+    }
+}
+
+// one pass of "neighborhoods" over copies of "individuals": ms per individual, mean improvement in % and lookups per second
+static void time_local_search(const string& label, const vector<Individual>& individuals, const vector<Neighborhood>& neighborhoods, shared_ptr<const Case> instance) {
+    Evaluator evaluator(instance);
+    double seconds = 0, improvement = 0;
+    for (const auto& original : individuals) {
+        Individual individual(original);
+        auto start = Clock::now();
+        for (Neighborhood neighborhood : neighborhoods) {
+            apply_neighborhood(neighborhood, individual, *instance, evaluator, ImprovementStrategy::BEST_IMPROVEMENT);
+        }
+        seconds += seconds_since(start);
+        improvement += 100.0 * (original.get_fit() - individual.get_fit()) / original.get_fit();
+    }
+    const double count = static_cast<double>(individuals.size());
+    cout << setw(16) << label << setprecision(2) << setw(12) << seconds / count * 1e3 << setw(10) << improvement / count
+         << setprecision(1) << setw(12) << evaluator.get_evals() * instance->actualProblemSize / seconds / 1e6 << "\n";
+}
+
+// The 2-opt that the granular engine replaced: first improvement over every pair (i, j), passes until none improves.
+// "moves" counts the evaluated moves.
+static double full_scan_two_opt(vector<int>& route, const Case& instance, long long& moves) {
+    bool improved = true;
+    double totalChange = 0.0;
+    while (improved) {
+        improved = false;
+        for (size_t i = 1; i < route.size() - 2; ++i) {
+            for (size_t j = i + 1; j < route.size() - 1; ++j) {
+                double oldCost = instance.distances(route[i - 1], route[i]) + instance.distances(route[j], route[j + 1]);
+                double newCost = instance.distances(route[i - 1], route[j]) + instance.distances(route[i], route[j + 1]);
+                moves++;
+                if (newCost < oldCost) {
+                    reverse(route.begin() + i, route.begin() + j + 1);
+                    improved = true;
+                    totalChange += newCost - oldCost;
+                }
+            }
+        }
+    }
+    return totalChange;
+}
+
+// 2-opt on every route of "routes" with both engines: ms for all the routes, million moves evaluated per second, improvement in %
+static void compare_two_opt(const string& label, const vector<vector<int>>& routes, const Case& instance, Evaluator& evaluator) {
+    double length = 0;
+    for (const auto& route : routes) {
+        for (size_t i = 1; i < route.size(); ++i) length += instance.distances(route[i - 1], route[i]);
+    }
+    for (bool granular : {true, false}) {
+        vector<vector<int>> improved = routes;
+        long long moves = 0;
+        double change = 0;
+        const double evals = evaluator.get_evals();
+        auto start = Clock::now();
+        for (auto& route : improved) {
+            change += granular ? two_opt_for_single_route(route, instance, evaluator) : full_scan_two_opt(route, instance, moves);
+        }
+        const double seconds = seconds_since(start);
+        if (granular) moves = llround((evaluator.get_evals() - evals) * instance.actualProblemSize / 4); // 4 lookups per move
+        cout << setw(22) << label << setw(10) << (granular ? "granular" : "full scan") << setprecision(2) << setw(10) << seconds * 1e3
+             << setw(10) << static_cast<double>(moves) / seconds / 1e6 << setw(8) << -100.0 * change / length << "\n";
+    }
+}
+
+// user-011, user-013, user-015, user-016: the neighbourhoods on split individuals, then the granular 2-opt against K
+static void bench_ls() {
+    const pair<string, Neighborhood> neighborhoods[] = {{"2-opt", Neighborhood::TWO_OPT}, {"2-opt*", Neighborhood::TWO_OPT_STAR},
+                                                        {"node shift", Neighborhood::NODE_SHIFT}, {"relocate", Neighborhood::RELOCATE},
+                                                        {"swap", Neighborhood::SWAP}, {"swap*", Neighborhood::SWAP_STAR},
+                                                        {"cross exchange", Neighborhood::CROSS_EXCHANGE}};
+    header("ls: one pass on 10 split individuals, ms per individual, improvement %, million lookups/s");
+    for (const string name : {"X-n916-k207", "X-n1001-k43"}) {
+        auto instance = load(name);
+        vector<Individual> individuals = split_individuals(instance, 10);
+        cout << name << "\n";
+        for (const auto& [label, neighborhood] : neighborhoods) {
+            time_local_search(label, individuals, {neighborhood}, instance);
+        }
+    }
+
+    header("ls: 2-opt, 2-opt* and relocate against granular K on X-n1001-k43");
+    for (int k : {10, 20, 40, 80, 1000}) {
+        auto instance = load("X-n1001-k43", k);
+        time_local_search("K " + to_string(instance->granularK), split_individuals(instance, 10),
+                          {Neighborhood::TWO_OPT, Neighborhood::TWO_OPT_STAR, Neighborhood::RELOCATE}, instance);
+    }
+
+    header("ls: 2-opt engines on X-n1001-k43, ms, million moves evaluated/s, improvement %");
+    auto instance = load("X-n1001-k43");
+    Evaluator evaluator(instance);
+    vector<vector<int>> routes = split_individuals(instance, 1)[0].get_routes();
+    compare_two_opt(to_string(routes.size()) + " split routes", routes, *instance, evaluator);
+    vector<int> tour = giant_tours(*instance, 1)[0];
+    tour.push_back(instance->depot);
+    compare_two_opt("one route of " + to_string(tour.size()) + " nodes", {tour}, *instance, evaluator);
+}
+
+// user-019: the recharging of split individuals, one station per edge, then the two-station chains of the refinement
+static void bench_repair() {
+    header("repair: ms per individual, without the repair cache");
+    cout << setw(14) << "instance" << setw(8) << "routes" << setw(10) << "fix" << setw(10) << "refine" << "\n";
+    for (const string name : {"E-n101-k8", "X-n916-k207", "X-n1001-k43"}) {
+        auto instance = load(name);
+        vector<Individual> individuals = split_individuals(instance, 10);
+        Evaluator evaluator(instance);
+        double fix = 0, refine = 0;
+        for (auto& individual : individuals) {
+            auto start = Clock::now();
+            fix_one_solution(individual, *instance, evaluator);
+            fix += seconds_since(start);
+            start = Clock::now();
+            refine_individual(individual, *instance, evaluator);
+            refine += seconds_since(start);
+        }
+        const double count = static_cast<double>(individuals.size());
+        cout << setw(14) << name << setw(8) << individuals[0].route_num << setprecision(3) << setw(10) << fix / count * 1e3 << setw(10) << refine / count * 1e3 << "\n";
+    }
+}
+
+// a whole run as MA::run does it, without the logs: best fitness and seconds
+static pair<double, double> run_ma(shared_ptr<const Case> instance, int seed, const vector<Neighborhood>& neighborhoods = {}, int threadNum = 1, int generations = 0) {
+    auto start = Clock::now();
+    MA ma(instance, seed, 1);
+    ma.set_thread_num(threadNum);
+    if (!neighborhoods.empty()) ma.localSearchNeighborhoods = neighborhoods;
+    ma.initialize_heuristic();
+    while (generations > 0 ? ma.gen < generations : !ma.termination_criteria_1()) {
+        ma.run_heuristic();
+    }
+    if (generations == 0) refine_individual(*ma.globalBest, *ma.instance, ma.evaluator);
+    return {ma.globalBest->get_fit(), seconds_since(start)};
+}
+
+// user-011, user-016: quality per second of whole runs, with the optional neighbourhoods and other granular K
+static void bench_ma() {
+    header("ma: whole runs (max-evals), mean over seeds 1-3 of the best fitness and of the seconds");
+    const vector<Neighborhood> defaults = MA(load("E-n22-k4"), 1).localSearchNeighborhoods;
+    vector<Neighborhood> withSwapStar = defaults, withCrossExchange = defaults;
+    withSwapStar.push_back(Neighborhood::SWAP_STAR);
+    withCrossExchange.push_back(Neighborhood::CROSS_EXCHANGE);
+    const tuple<string, vector<Neighborhood>, int> configs[] = {{"default", defaults, Case::DEFAULT_GRANULAR_K},
+                                                                {"+ swap*", withSwapStar, Case::DEFAULT_GRANULAR_K},
+                                                                {"+ cross exchange", withCrossExchange, Case::DEFAULT_GRANULAR_K},
+                                                                {"K 10", defaults, 10}, {"K 20", defaults, 20}, {"K all", defaults, 1000}};
+    for (const string name : {"E-n22-k4", "E-n51-k5", "E-n76-k7"}) {
+        cout << name << "\n";
+        for (const auto& [label, neighborhoods, k] : configs) {
+            double best = 0, seconds = 0;
+            for (int seed = 1; seed <= 3; ++seed) {
+                auto [fit, time] = run_ma(load(name, k), seed, neighborhoods);
+                best += fit / 3;
+                seconds += time / 3;
+            }
+            cout << setw(18) << label << setprecision(2) << setw(10) << best << setw(8) << seconds << endl;
+        }
+    }
+}
+
+// user-023: generation time against the threads of a run, the result must not depend on them
+static void bench_threads() {
+    header("threads: 20 generations on X-n214-k11, seconds per generation and best fitness");
+    auto instance = load("X-n214-k11");
+    vector<int> threadNums = {1, 2, 4};
+    if (ThreadPool::default_thread_num() > 4) threadNums.push_back(ThreadPool::default_thread_num());
+    for (int threadNum : threadNums) {
+        auto [fit, seconds] = run_ma(instance, 1, {}, threadNum, 20);
+        cout << setw(4) << threadNum << " threads" << setprecision(3) << setw(10) << seconds / 20 << setprecision(4) << setw(14) << fit << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const pair<string, void (*)()> sections[] = {{"parse", bench_parse}, {"storage", bench_storage}, {"scan", bench_scan},
+                                                 {"split", bench_split}, {"ls", bench_ls}, {"repair", bench_repair},
+                                                 {"ma", bench_ma}, {"threads", bench_threads}};
+    vector<string> wanted(argv + 1, argv + argc);
+    for (const auto& [name, section] : sections) {
+        if (wanted.empty() || find(wanted.begin(), wanted.end(), name) != wanted.end()) section();
+    }
+    return 0;
+}
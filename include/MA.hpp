@@ -8,9 +8,9 @@
 #include <random>
 #include <algorithm>
 #include <iterator>
-#include <deque>
 
 #include "case.hpp"
+#include "evaluator.hpp"
 #include "stats.hpp"
 #include "utils.hpp"
 #include "individual.hpp"
@@ -20,10 +20,12 @@ using namespace std;
 class MA : public StatsInterface{
 public:
     static vector<double> get_fitness_vector_from_group(const vector<shared_ptr<Individual>>& group) ;
+    static void get_fitness_vector_from_group(const vector<shared_ptr<Individual>>& group, vector<double>& fitness); // into a reused buffer
 
-    MA(Case* instance, int seed, int isMaxEvals = 1, int popSize = 100, double eliteRatio = 0.01, double immigrantRatio = 0.05,
+    MA(shared_ptr<const Case> instance, int seed, int isMaxEvals = 1, int popSize = 100, double eliteRatio = 0.01, double immigrantRatio = 0.05,
        double crossoverProb = 1.0, double mutationProb = 0.5, double mutationIndProb = 0.2, int tournamentSize = 2);
     ~MA() override;
+    void set_thread_num(int threadNum); // threads of the local search, recharging and offspring stages, 1 (no pool) by default
     void run();
     void initialize_heuristic();
     void run_heuristic();
@@ -32,13 +34,20 @@ public:
     void pop_init_with_clustering(); // hien clustering
     void pop_init_with_order_split(); // random order first, split second
     void pop_init_with_direct_encoding(); // direct encoding approach
+    void local_search(Individual& ind, Evaluator& runEvaluator); // applies localSearchNeighborhoods in order
+    template <typename Body>
+    void for_each_task(int taskNum, const Body& body); // body(i, evaluator of task i), in parallel with a pool
+    static std::default_random_engine task_random_engine(int seed, int gen, int task); // the random stream of a task of generation "gen"
     void open_log_for_evolution() override;
     void flush_row_into_evol_log() override;
     void close_log_for_evolution() override;
     void save_log_for_solution() override;
 
     std::ostringstream ossRowEvol;
-    Case* instance;
+    shared_ptr<const Case> instance; // shared by all the runs, read-only
+    Evaluator evaluator; // per-run evaluation counter
+    RepairCache repairCache; // per-run memo of fix_one_solution, shared by the tasks of the pool
+    unique_ptr<ThreadPool> pool; // intra-run parallelism of the local search, recharging and offspring stages, null for a sequential run
     std::default_random_engine randomEngine;
     uniform_real_distribution<double> uniformRealDis;
     std::vector<std::shared_ptr<Individual>> population;
@@ -57,6 +66,9 @@ public:
     double mutationProb;
     double mutationIndProb;
     int tournamentSize;
+    vector<Neighborhood> localSearchNeighborhoods; // the S1 local search, applied in order
+    ImprovementStrategy localSearchStrategy; // move selection of the neighbourhoods that support both
+    SplitMethod splitMethod; // decoding of the giant tours of the initial order-split population and of the offspring
 
     int routeCapacity;
     int nodeCapacity;
@@ -64,7 +76,41 @@ public:
     double gammaL; // confidence ratio of local search: 调大可以增加local search的解的个数
     double gammaR; // confidence ratio of recharging: 调小可以增加recharging的解的个数
     int delta;  // confidence interval
-    deque<double> P; // list for confidence intervals of local search
+    vector<double> P; // list for confidence intervals of local search, the last delta ones
     double r; // confidence interval is used to judge whether an upper-level sub-solution should make the charging process
+
+    // the buffers of a generation, sized in initialize_heuristic: once they have grown a generation allocates nothing
+    enum Mating {PROMISING_X_AVERAGE, PROMISING_X_IMMIGRANT, PROMISING_X_PROMISING};
+    vector<shared_ptr<Individual>> S1, S2, S3;
+    vector<double> fitness; // of the group the statistics are taken on
+    vector<double> improvements; // by the local search of S1
+    vector<double> increases; // by the recharging of S2
+    vector<vector<int>> promisingSeqs; // the chromosomes of S3, the first promisingNum rows
+    vector<vector<int>> averageSeqs; // the chromosomes of the rest of the population, the first averageNum rows
+    int promisingNum;
+    int averageNum;
+    vector<Mating> matings;
+    vector<vector<int>> chromosomes; // the offspring, two per mating
+    vector<Evaluator> taskEvaluators; // of the tasks of for_each_task
 };
+
+// Every task has its own Evaluator, also without a pool, and the task counters are merged in index order afterwards:
+// the total is bit-identical whatever the number of threads and the scheduling. The pool hands the tasks out one by
+// one, so a slow task does not hold up the others.
+template <typename Body>
+void MA::for_each_task(int taskNum, const Body& body) {
+    taskEvaluators.assign(taskNum, Evaluator(instance));
+    if (pool == nullptr) {
+        for (int i = 0; i < taskNum; ++i) {
+            body(i, taskEvaluators[i]);
+        }
+    } else {
+        pool->parallel_for(0, taskNum, [&](int i) {
+            body(i, taskEvaluators[i]);
+        });
+    }
+    for (auto& taskEvaluator : taskEvaluators) {
+        evaluator.charge_evaluations(taskEvaluator.get_evals());
+    }
+}
 #endif //CEVRP_YINGHAO_MA_HPP
@@ -11,43 +11,61 @@
 #include <vector>
 #include <set>
 #include <cstring>
+#include <cstdint>
+#include <climits>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <stdexcept>
 #include <map>
 #include <unordered_map>
 #include <algorithm>
 #include <cmath>
 #include <cfloat>
 #include <cstdio>
+#include <chrono>
+#include <memory>
+
+#include "matrix.hpp"
+#include "distance_matrix.hpp"
+#include "thread_pool.hpp"
 
 
 
 using namespace std;
 
+class MappedFile;
+
+// The problem instance and every table derived from it. A Case is immutable once constructed,
+// so one object (shared_ptr<const Case>) serves all the runs; the per-run state lives in Evaluator.
 class Case {
 public:
     static const int MAX_EVALUATION_FACTOR;
+    static const int DEFAULT_GRANULAR_K; // neighbours kept per node for the granular local search
 
 
-    Case(const string& filepath, int id);
-    ~Case();
+    explicit Case(const string& filepath, DistanceStorage distanceStorage = DistanceStorage::FULL_DOUBLE, bool useCache = true, int granularK = DEFAULT_GRANULAR_K);
     void read_problem(const string& filepath);					//reads .evrp file
-    double euclidean_distance(int i, int j);
-    void init_customer_clusters_map();
+    void init_problem_variables(); // variables derived from the parsed file in O(N)
+    void init_derived_tables(); // distances, bestStation and the per-customer lists
+    [[nodiscard]] double euclidean_distance(int i, int j) const;
+    void init_best_station(ThreadPool& pool);
+    void init_feasible_station_lists(ThreadPool& pool);
+    void init_customer_clusters_map(ThreadPool& pool);
     void init_customer_nearest_station_map();
-    static double **generate_2D_matrix_double(int n, int m);
+    void init_neighbor_lists(); // built from customerClusters, never cached since it depends on granularK
+    void init_station_distances(); // O(N S), rebuilt on every load rather than cached
     [[nodiscard]] int get_customer_demand(int customer) const;				//returns the customer demand
-    double get_distance(int from, int to);				//returns the distance
-    [[nodiscard]] double get_evals() const;									//returns the number of evaluations
-    double fitness_evaluation(const vector<vector<int>>& routes); // customized fitness function
+    [[nodiscard]] ConstSpan<int> get_customer_cluster(int customer) const; // the other customers from near to far
+    [[nodiscard]] ConstSpan<int> get_neighbors(int node) const { return {neighbors.data() + neighborStart[node], neighborStart[node + 1] - neighborStart[node]}; } // the granularK nearest nodes, near to far
     [[nodiscard]] double fitness_evaluation(const vector<int>& route) const; // used for testing TODO: DELETE on Release
-    vector<int> compute_demand_sum(const vector<vector<int>>& routes); // compute the demand sum of all customers for each route.
+    [[nodiscard]] vector<int> compute_demand_sum(const vector<vector<int>>& routes) const; // compute the demand sum of all customers for each route.
     [[nodiscard]] int find_best_station(int from, int to) const;
     [[nodiscard]] int find_best_station_feasible(int from, int to, double max_dis) const; // the station within allowed max distance from "from", and min dis[from][s]+dis[to][s]
-    int find_nearest_station_to_y_feasible(int x, int y, double max_dis); // find the nearest station to y, and meanwhile the station is reachable for x
-    bool is_charging_station(int node) const;					//returns true if node is a charging station
+    [[nodiscard]] int find_nearest_station_to_y_feasible(int x, int y, double max_dis) const; // the station nearest to y among those within max_dis of x
+    [[nodiscard]] bool is_charging_station(int node) const;					//returns true if node is a charging station
 
 
-    int ID;
     string fileName;
     string instanceName;
 
@@ -66,14 +84,27 @@ public:
     vector<int> stations;
     double maxDis;
     int totalDem;
-    double** distances;
+    int maxRouteLength; // upper bound on the nodes of a capacity-feasible route, both depot visits included
+    DistanceStorage distanceStorage;
+    DistanceMatrix distances; // every lookup goes through distances(from, to), whatever the storage policy
     double optimum;
-    int** bestStation; // "bestStation" is designed for two customers, bringing the minimum extra cost.
-    unordered_map<int, vector<int>> customerClustersMap; // For Hien's clustering usage only. For each customer, a list of customer nodes from near to far, e.g., {1: [5,3,2,6], 2: [], ...}
+    Matrix<int> bestStation; // "bestStation" is designed for two customers, bringing the minimum extra cost.
+    // Per customer-pair edge (from, to), the stations s with d(to, s) < maxDis, by increasing d(from, s) + d(to, s), keeping only
+    // those closer to "from" than every station before them: the answer of find_best_station_feasible is the first one within range.
+    // The slots of edge (from, to) are feasibleStations[0][feasibleStationStart[from][to] .. feasibleStationStart[from][to + 1]).
+    // Empty (and find_best_station_feasible scans) with the memory-saving distance storages.
+    Matrix<int> feasibleStationStart;
+    Matrix<uint16_t> feasibleStations; // a single row of station slots
+    Matrix<int> customerClusters; // For Hien's clustering usage only. Row c lists the other customer nodes from near to far, e.g., row 1: [5,3,2,6]; row 0 (depot) is unused
+    int granularK; // length of the neighbour lists, clamped to the number of candidates
+    vector<int> neighborStart; // CSR offsets: the neighbours of node i are neighbors[neighborStart[i] .. neighborStart[i + 1])
+    vector<int> neighbors; // depot and customers only, a station has an empty list
+    Matrix<double> stationDistances; // node-major station slice, stationDistances[i][s] = d(i, stations[s]), scanned by station_scan
     unordered_map<int, pair<int, double>> customerNearestStationMap; // for each customer, find the nearest station and store the corresponding distance
-    double evals;
     double maxEvals;
     int maxExecTime; // unit seconds
+    double preprocessingTime; // unit seconds, time spent on reading the file and building the derived tables
+    shared_ptr<const MappedFile> cacheMapping; // keeps the mapped .evrpbin alive when the tables above are views into it
 };
 
 
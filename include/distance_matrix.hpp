@@ -0,0 +1,73 @@
+#ifndef CEVRP_YINGHAO_DISTANCE_MATRIX_HPP
+#define CEVRP_YINGHAO_DISTANCE_MATRIX_HPP
+
+#include <vector>
+#include <cmath>
+#include <utility>
+
+#include "matrix.hpp"
+
+using namespace std;
+
+
+// How the pairwise EUC_2D distances are kept in memory
+enum class DistanceStorage {
+    FULL_DOUBLE,        // N x N doubles, the fastest lookup
+    FULL_FLOAT,         // N x N floats, half of the memory, ~1e-7 relative rounding
+    PACKED_TRIANGULAR,  // N (N + 1) / 2 doubles, exploits the symmetry d(i, j) = d(j, i)
+    ON_THE_FLY          // nothing but the coordinates, every lookup computes a square root
+};
+
+// Symmetric distance table with a selectable storage policy, all of them served by one accessor.
+class DistanceMatrix {
+public:
+    static double euclidean(const pair<double, double>& a, const pair<double, double>& b);
+    static size_t payload_size(DistanceStorage storage, int size); // in bytes, the serialized table of "size" nodes
+
+    DistanceMatrix() = default;
+    DistanceMatrix(const vector<pair<double, double>>& positions, DistanceStorage storage);
+    DistanceMatrix(const vector<pair<double, double>>& positions, DistanceStorage storage, const void* payload); // read-only view over a serialized table
+
+    [[nodiscard]] const void* payload() const; // the table as laid out in memory, nullptr when nothing is stored
+    [[nodiscard]] size_t payload_size() const; // in bytes
+
+    inline double operator()(int from, int to) const;
+    [[nodiscard]] DistanceStorage get_storage() const { return storage; }
+    [[nodiscard]] int get_size() const { return size; }
+    [[nodiscard]] size_t memory_usage() const; // in bytes
+
+private:
+    void init_packed_row_start();
+    void init_coordinates(const vector<pair<double, double>>& positions);
+
+    DistanceStorage storage = DistanceStorage::FULL_DOUBLE;
+    int size = 0;
+    Matrix<double> fullDouble;
+    Matrix<float> fullFloat;
+    vector<double> packedStorage; // upper triangle (diagonal included), row by row, unless "packed" views external memory
+    const double* packed = nullptr;
+    vector<size_t> packedRowStart; // packed[packedRowStart[i] + j] is d(i, j) for i <= j
+    vector<double> xs;
+    vector<double> ys;
+};
+
+
+inline double DistanceMatrix::operator()(int from, int to) const {
+    switch (storage) {
+        case DistanceStorage::FULL_DOUBLE:
+            return fullDouble[from][to];
+        case DistanceStorage::FULL_FLOAT:
+            return fullFloat[from][to];
+        case DistanceStorage::PACKED_TRIANGULAR:
+            if (from > to) std::swap(from, to);
+            return packed[packedRowStart[from] + to];
+        default: {
+            double xd = xs[from] - xs[to];
+            double yd = ys[from] - ys[to];
+            return sqrt(xd * xd + yd * yd);
+        }
+    }
+}
+
+
+#endif //CEVRP_YINGHAO_DISTANCE_MATRIX_HPP
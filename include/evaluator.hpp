@@ -0,0 +1,43 @@
+#ifndef CEVRP_YINGHAO_EVALUATOR_HPP
+#define CEVRP_YINGHAO_EVALUATOR_HPP
+
+#include <vector>
+#include <memory>
+
+#include "case.hpp"
+
+using namespace std;
+
+
+// Per-run evaluation context on top of a shared, immutable Case.
+// Every distance lookup or full fitness evaluation of a run goes through its Evaluator, which charges the
+// evaluation budget: 1 for a full evaluation, 1/actualProblemSize for a partial (single distance) one.
+class Evaluator {
+public:
+    explicit Evaluator(shared_ptr<const Case> instance);
+
+    inline double get_distance(int from, int to);				//returns the distance and counts a partial evaluation
+    void charge_partial_evaluations(long long count) { evals += static_cast<double>(count) / instance->actualProblemSize; } // "count" lookups made straight on the Case
+    void charge_evaluations(double amount) { evals += amount; } // replays the charge of a memoized computation
+    double fitness_evaluation(const vector<vector<int>>& routes); // customized fitness function
+    double fitness_evaluation(int* const* routes, const int* nodeNum, int routeNum); // same, on the arrays of an Individual
+    int find_nearest_station_to_y_feasible(int x, int y, double max_dis); // find the nearest station to y, and meanwhile the station is reachable for x
+    [[nodiscard]] double get_evals() const;									//returns the number of evaluations
+    [[nodiscard]] const Case& get_instance() const { return *instance; }
+
+private:
+    shared_ptr<const Case> instance;
+    double evals;
+};
+
+
+inline double Evaluator::get_distance(int from, int to) {
+    //adds partial evaluation to the overall fitness evaluation count
+    //It can be used when local search is used and a whole evaluation is not necessary
+    evals += (1.0 / instance->actualProblemSize);
+
+    return instance->distances(from, to);
+}
+
+
+#endif //CEVRP_YINGHAO_EVALUATOR_HPP
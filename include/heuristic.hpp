@@ -38,7 +38,6 @@ void run_heuristic();
 void run_heuristic_with_confidence_based_selection(long long duration);
 void run_heuristic_with_confidence_based_selection_flow(long long duration);
 void run_heuristic_with_confidence_based_selection_switch(long long duration);
-void refine();
 
 
 
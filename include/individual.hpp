@@ -8,41 +8,69 @@
 #include <iostream>
 #include <vector>
 #include <cstring>
+#include <stdexcept>
 
 
 using namespace std;
 
+// The fixed-size arrays of an individual live in one arena: the route pointers, node_num, demand_sum, route_flags and
+// route_cap slots of node_cap nodes each. Copying an individual is one memcpy of the arena plus re-basing the route pointers.
 class Individual {
 public:
-    static const int TOUR_SIZE;
+    // local searches that have converged on a route and need not scan it again until it changes
+    enum RouteFlag : int {
+        TWO_OPT_DONE = 1,
+        TWO_OPT_STAR_DONE = 2, // with every other route flagged the same way
+        NODE_SHIFT_DONE = 4,
+        RELOCATE_DONE = 8 // with every other route flagged the same way
+    };
 
     int route_cap; // route capacity - 2 by MIN_VEHICLES
-    int node_cap; // node capacity - NUM_OF_CUSTOMERS + num_of_depot
-    int** routes;
+    int node_cap; // node capacity - the longest capacity-feasible route, both depot visits included
+    int** routes; // routes[i] points to one of the slots, operators may swap them
     int route_num; // the actual number of routes for the solution
     int* node_num; // the node number of each route
     int* demand_sum; // the demand sum of all customers of each route
+    int* route_flags; // RouteFlag bits of each route, cleared whenever an operator modifies the route
     double fit;
-    int* tour; // The specified format of the solution, e.g., 0 - 5 - 6 - 8 - 0 - 1 - 2 - 3 - 4 - 0 - 7 - 0
-    int steps;
+    vector<int> tour; // The specified format of the solution, e.g., 0 - 5 - 6 - 8 - 0 - 1 - 2 - 3 - 4 - 0 - 7 - 0, sized by set_tour
+    int steps; // tour.size()
 
     Individual(const Individual  &ind);
     Individual(int route_cap, int node_cap);
     Individual(int route_cap, int node_cap, const vector<vector<int>>& routes, double fit, const vector<int>& demand_sum);
     ~Individual();
 
+    Individual& operator=(const Individual& ind);
+
     void reset();
+    void assign(const vector<vector<int>>& _routes, double _fit, const vector<int>& _demand_sum); // refills the individual in place, no allocation
+    void append_route(int depot, const int* customers, int count, int demand); // adds the route depot - customers - depot, after a reset
     [[nodiscard]] vector<vector<int>> get_routes() const;
     [[nodiscard]] vector<int> get_chromosome() const;
+    void get_chromosome(vector<int>& chromosome) const; // into a reused buffer
     [[nodiscard]] double get_fit() const;
     void set_fit(double _fit);
     void set_routes(const vector<vector<int>>& _routes) const;
     pair<int*, int> get_tour();
     void set_tour(const vector<vector<int>>& repaired_routes);
+    void set_tour(const int* repaired_tour, int length); // a whole tour, depot first and last
+    [[nodiscard]] size_t memory_usage() const; // in bytes
+    [[nodiscard]] bool is_route_done(int route, RouteFlag flag) const { return route_flags[route] & flag; }
+    void set_route_done(int route, RouteFlag flag) { route_flags[route] |= flag; }
+    void mark_route_changed(int route) { route_flags[route] = 0; }
 
 
 
     friend ostream& operator<<(ostream& os, const Individual& individual);
+
+private:
+    [[nodiscard]] static size_t arena_size(int route_cap, int node_cap);
+    void allocate(int route_cap, int node_cap); // carves the arrays out of a new arena, the content is left undefined
+    void copy_from(const Individual& ind); // same capacities required
+
+    char* arena;
+    int* slots; // route_cap * node_cap nodes
 };
 
 #endif //CEVRP_YINGHAO_INDIVIDUAL_HPP
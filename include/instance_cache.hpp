@@ -0,0 +1,44 @@
+#ifndef CEVRP_YINGHAO_INSTANCE_CACHE_HPP
+#define CEVRP_YINGHAO_INSTANCE_CACHE_HPP
+
+#include <string>
+#include <cstdint>
+
+#include "case.hpp"
+
+using namespace std;
+
+
+// Read-only memory mapping of a whole file. Pages are shared through the OS page cache,
+// so concurrent processes mapping the same file do not duplicate it.
+class MappedFile {
+public:
+    explicit MappedFile(const string& path); // maps nothing if the file cannot be opened or is empty
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] const char* data() const { return bytes; }
+    [[nodiscard]] size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+};
+
+
+// Versioned binary image (.evrpbin, next to the .evrp file) of a parsed instance and its derived tables.
+// The image is keyed by a hash of the .evrp content and by the distance storage policy; on a hit, the
+// distance matrix, bestStation, the feasible station lists and the customer clusters are served directly from the read-only mapping.
+class InstanceCache {
+public:
+    static const uint32_t VERSION; // bump it whenever the layout or the content of the derived tables changes
+
+    static string cache_path(const string& filepath);
+    static uint64_t hash_file(const string& filepath); // 64-bit FNV-1a of the file content, 0 if unreadable
+    static bool load(Case& instance, const string& filepath); // false if there is no valid cache, "instance" is then untouched
+    static bool save(const Case& instance, const string& filepath); // false if the cache cannot be written, which is harmless
+};
+
+
+#endif //CEVRP_YINGHAO_INSTANCE_CACHE_HPP
@@ -0,0 +1,123 @@
+#ifndef CEVRP_YINGHAO_MATRIX_HPP
+#define CEVRP_YINGHAO_MATRIX_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+
+// Read-only view over a contiguous run of elements, e.g. the used part of a matrix row
+template <typename T>
+struct ConstSpan {
+    const T* first = nullptr;
+    int length = 0;
+
+    const T* begin() const { return first; }
+    const T* end() const { return first + length; }
+    [[nodiscard]] int size() const { return length; }
+    const T& operator[](int i) const { return first[i]; }
+};
+
+
+// Contiguous row-major matrix in a single 64-byte aligned block.
+// Each row is padded so that its stride is a multiple of the cache line (and SIMD) width,
+// which keeps every row aligned and lets "matrix[i][j]" be resolved without chasing a row pointer.
+// A matrix either owns its block or is a read-only view over external memory laid out the same way (e.g. a mapped file).
+template <typename T>
+class Matrix {
+public:
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    static int stride_of(int cols); // padded row length for "cols" elements
+
+    Matrix() = default;
+    Matrix(int rows, int cols);
+    Matrix(const T* external, int rows, int cols); // non-owning view, the memory must outlive the matrix
+    Matrix(const Matrix& other) = delete;
+    Matrix(Matrix&& other) noexcept;
+    ~Matrix();
+
+    Matrix& operator=(const Matrix& other) = delete;
+    Matrix& operator=(Matrix&& other) noexcept;
+
+    T* operator[](int row) { return elements + static_cast<std::size_t>(row) * stride; }
+    const T* operator[](int row) const { return elements + static_cast<std::size_t>(row) * stride; }
+
+    void fill(const T& value);
+    T* data() { return elements; }
+    [[nodiscard]] const T* data() const { return elements; }
+    [[nodiscard]] int get_rows() const { return rows; }
+    [[nodiscard]] int get_cols() const { return cols; }
+    [[nodiscard]] int get_stride() const { return stride; } // number of elements between two consecutive rows
+    [[nodiscard]] std::size_t memory_usage() const { return static_cast<std::size_t>(rows) * stride * sizeof(T); } // in bytes
+    [[nodiscard]] bool is_view() const { return !owning; }
+
+private:
+    T* elements = nullptr;
+    bool owning = true;
+    int rows = 0;
+    int cols = 0;
+    int stride = 0;
+};
+
+
+template <typename T>
+int Matrix<T>::stride_of(int cols) {
+    constexpr int lane = ALIGNMENT / sizeof(T) > 0 ? ALIGNMENT / sizeof(T) : 1;
+    return (cols + lane - 1) / lane * lane;
+}
+
+template <typename T>
+Matrix<T>::Matrix(int rows, int cols) : rows(rows), cols(cols) {
+    this->stride = stride_of(cols);
+    std::size_t bytes = memory_usage();
+    if (bytes == 0) return;
+    this->elements = static_cast<T*>(std::aligned_alloc(ALIGNMENT, bytes));
+    if (this->elements == nullptr) throw std::bad_alloc();
+    memset(this->elements, 0, bytes);
+}
+
+template <typename T>
+Matrix<T>::Matrix(const T* external, int rows, int cols)
+: elements(const_cast<T*>(external)), owning(false), rows(rows), cols(cols), stride(stride_of(cols)) {
+}
+
+template <typename T>
+Matrix<T>::Matrix(Matrix&& other) noexcept
+: elements(other.elements), owning(other.owning), rows(other.rows), cols(other.cols), stride(other.stride) {
+    other.elements = nullptr;
+    other.owning = true;
+    other.rows = other.cols = other.stride = 0;
+}
+
+template <typename T>
+Matrix<T>::~Matrix() {
+    if (owning) std::free(elements);
+}
+
+template <typename T>
+Matrix<T>& Matrix<T>::operator=(Matrix&& other) noexcept {
+    if (this != &other) {
+        if (owning) std::free(elements);
+        elements = std::exchange(other.elements, nullptr);
+        owning = std::exchange(other.owning, true);
+        rows = std::exchange(other.rows, 0);
+        cols = std::exchange(other.cols, 0);
+        stride = std::exchange(other.stride, 0);
+    }
+    return *this;
+}
+
+template <typename T>
+void Matrix<T>::fill(const T& value) {
+    for (int i = 0; i < rows; ++i) {
+        T* row = (*this)[i];
+        for (int j = 0; j < cols; ++j) {
+            row[j] = value;
+        }
+    }
+}
+
+
+#endif //CEVRP_YINGHAO_MATRIX_HPP
@@ -0,0 +1,55 @@
+#ifndef CEVRP_YINGHAO_REPAIR_CACHE_HPP
+#define CEVRP_YINGHAO_REPAIR_CACHE_HPP
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+using namespace std;
+
+
+// Bounded LRU memo of the recharging step: route (depot - customers - depot) -> repaired route and its cost.
+// Keys are a 64-bit hash of the node sequence, and a hit is confirmed against the stored route, so a collision is
+// only a miss. An entry also keeps the evaluations its repair was charged, which the caller charges again on a hit:
+// the cache saves time, the evaluation budget is spent exactly as without it.
+// One cache per run (MA owns it), shared by the threads of the run under a mutex: a lookup is tiny next to a repair.
+// The cache allocates while it grows to its capacity; a full cache recycles its evicted entries and their buffers.
+class RepairCache {
+public:
+    static const size_t DEFAULT_CAPACITY;
+
+    struct Entry {
+        vector<int> route;
+        vector<int> repaired; // empty when the route has no recharging plan
+        double cost; // -1 when the route has no recharging plan
+        double evals; // evaluations charged by the repair
+    };
+
+    explicit RepairCache(size_t capacity = DEFAULT_CAPACITY);
+    static uint64_t hash_route(const int* route, int length);
+
+    bool find(const int* route, int length, pair<double, vector<int>>& result, double& evals); // on a hit, copies the entry out and makes it the most recently used
+    void insert(const int* route, int length, double cost, const vector<int>& repaired, double evals); // evicts the least recently used entry when full
+    void clear();
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] size_t get_capacity() const { return capacity; }
+    [[nodiscard]] long long get_hits() const;
+    [[nodiscard]] long long get_misses() const;
+    [[nodiscard]] double hit_rate() const;
+
+private:
+    size_t capacity;
+    list<pair<uint64_t, Entry>> entries; // most recently used first
+    unordered_map<uint64_t, list<pair<uint64_t, Entry>>::iterator> index;
+    long long hits = 0;
+    long long misses = 0;
+    mutable mutex mtx;
+};
+
+
+#endif //CEVRP_YINGHAO_REPAIR_CACHE_HPP
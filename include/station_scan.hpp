@@ -0,0 +1,24 @@
+#ifndef CEVRP_YINGHAO_STATION_SCAN_HPP
+#define CEVRP_YINGHAO_STATION_SCAN_HPP
+
+
+// Arguments of one scan over the stations. "a" and "b" are rows of a node-major station slice, i.e. a[s] and b[s]
+// are the distances from two nodes to the s-th station, "count" stations long.
+struct StationScan {
+    const double* a;
+    const double* b;
+    int count;
+    bool keyIncludesA; // the key is a[s] + b[s] when true, b[s] alone otherwise
+    double limitA;     // a station is admissible only when a[s] < limitA ...
+    double limitB;     // ... and b[s] < limitB
+    int skip1;         // slots never chosen, -1 for none
+    int skip2;
+};
+
+// The admissible slot of minimum key, the lowest slot on ties, -1 when no slot is admissible or every key is DBL_MAX or more.
+// Same result as the plain scalar loop; long slices are scanned with AVX when the compiler targets it.
+int station_scan(const StationScan& scan);
+const char* station_scan_isa(); // the instruction set station_scan was compiled for
+
+
+#endif //CEVRP_YINGHAO_STATION_SCAN_HPP
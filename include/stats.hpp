@@ -37,7 +37,7 @@ public:
 
     static PopulationMetrics calculate_population_metrics(const std::vector<double>& data) ;
     static bool create_directories_if_not_exists(const std::string& directoryPath);
-    static void stats_for_multiple_trials(const std::string& filePath, const std::vector<double>& data); // open a file, save the statistical info, and then close it
+    static void stats_for_multiple_trials(const std::string& filePath, const std::vector<double>& data, double preprocessingTime); // open a file, save the statistical info, and then close it
     virtual void open_log_for_evolution() = 0; // open a file
     virtual void flush_row_into_evol_log() = 0; // flush the evolution info into the file
     virtual void close_log_for_evolution() = 0; // close the file
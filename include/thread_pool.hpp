@@ -0,0 +1,50 @@
+#ifndef CEVRP_YINGHAO_THREAD_POOL_HPP
+#define CEVRP_YINGHAO_THREAD_POOL_HPP
+
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+
+using namespace std;
+
+
+// A fixed set of worker threads running data-parallel loops.
+// parallel_for hands out the index range in chunks of "grain" indices; the calling thread takes part in the work
+// and the call returns once every index has been processed. With a single thread the loop simply runs inline.
+// parallel_for is not reentrant: the body must not call parallel_for on the same pool.
+class ThreadPool {
+public:
+    static int default_thread_num(); // number of hardware threads, at least 1
+
+    explicit ThreadPool(int threadNum = default_thread_num()); // threadNum counts the calling thread
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+    ~ThreadPool();
+
+    void parallel_for(int begin, int end, const function<void(int)>& body, int grain = 1);
+    [[nodiscard]] int get_thread_num() const;
+
+private:
+    void worker_loop();
+    void drain(const function<void(int)>& body);
+
+    vector<thread> workers;
+    mutex mtx;
+    condition_variable cvJob;
+    condition_variable cvDone;
+    const function<void(int)>* job = nullptr;
+    atomic<int> next{0};
+    int jobEnd = 0;
+    int jobGrain = 1;
+    int busy = 0; // workers currently inside drain()
+    unsigned long long generation = 0; // bumped for every new job
+    bool stopping = false;
+    exception_ptr failure;
+};
+
+
+#endif //CEVRP_YINGHAO_THREAD_POOL_HPP
@@ -14,48 +14,75 @@
 
 #include "individual.hpp"
 #include "case.hpp"
+#include "evaluator.hpp"
+#include "repair_cache.hpp"
 
 using namespace std;
 
 #define INFEASIBLE 1000000000
 
+// how a local search picks the move to apply among the improving ones it scans
+enum class ImprovementStrategy {
+    FIRST_IMPROVEMENT,
+    BEST_IMPROVEMENT
+};
+
+// the local search neighbourhoods that can be plugged into the S1 stage of the MA, see apply_neighborhood
+enum class Neighborhood {
+    TWO_OPT,        // intra-route
+    TWO_OPT_STAR,   // inter-route tail exchange
+    NODE_SHIFT,     // intra-route relocation of one customer
+    RELOCATE,       // Or-opt: intra and inter-route relocation of 1-3 customers
+    SWAP,           // inter-route exchange of two customers
+    SWAP_STAR,      // inter-route exchange of two customers, each re-inserted at its best position
+    CROSS_EXCHANGE  // inter-route exchange of two segments of 1-3 customers
+};
 
-// used in 2-opt*, define the hash relationship to make sure one-to-one mapping between route pairs
-struct pair_hash
-{
-    size_t operator() (pair<int, int> const & apair) const {
-        return apair.first * 256 + apair.second;
-    }
+// how a giant tour x = {depot, customers...} is cut into routes, see split_giant_tour
+enum class SplitMethod {
+    PRINS,       // O(n·B) Bellman relaxation
+    LINEAR,      // O(n) monotone queue, same optimal split
+    LINEAR_SOFT, // O(n) with a penalty on the excess load, then the overloaded routes are split again by LINEAR
+    ENERGY       // O(n·B·S), the cost of a route is its length once optimally recharged
 };
 
 
 // population initialization
-vector<vector<int>> prins_split(const vector<int>& x, Case& instance);
+vector<vector<int>> prins_split(const vector<int>& x, const Case& instance, Evaluator& evaluator);
+vector<vector<int>> linear_split(const vector<int>& x, const Case& instance, Evaluator& evaluator);
+vector<vector<int>> energy_split(const vector<int>& x, const Case& instance, Evaluator& evaluator, int maxStationsPerEdge = 1);
+vector<vector<int>> linear_split_soft(const vector<int>& x, const Case& instance, Evaluator& evaluator, double penalty); // the routes may exceed maxC
+vector<vector<int>> split_giant_tour(SplitMethod method, const vector<int>& x, const Case& instance, Evaluator& evaluator); // capacity-feasible routes, without the depots
+void decode_giant_tour(SplitMethod method, const vector<int>& x, const Case& instance, Evaluator& evaluator, Individual& individual, RepairCache* cache = nullptr); // split into the individual, with the depots, and evaluated; LINEAR and ENERGY allocate nothing; ENERGY puts its recharging plans in the cache
 vector<vector<int>> hien_clustering(const Case& instance, std::default_random_engine& rng);
 void hien_balancing(vector<vector<int>>& routes, const Case& instance, std::default_random_engine& rng);
-vector<vector<int>> routes_constructor_with_split(Case& instance, std::default_random_engine& rng);
+vector<vector<int>> routes_constructor_with_split(const Case& instance, Evaluator& evaluator, std::default_random_engine& rng, SplitMethod method = SplitMethod::LINEAR);
 vector<vector<int>> routes_constructor_with_hien_method(const Case& instance, std::default_random_engine& rng);
 vector<vector<int>> routes_construct_with_direct_encoding(const Case& instance, std::default_random_engine& rng);
 
 // local search operators
-double two_opt_for_single_route(vector<int>& route, Case& instance);
-bool two_opt_for_individual(Individual& individual, Case& instance);
-bool two_opt_star_for_individual(Individual& individual, Case& instance);
-bool node_shift(int* route, int length, double& fitv, Case& instance);
+double two_opt_for_single_route(vector<int>& route, const Case& instance, Evaluator& evaluator);
+bool two_opt_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator);
+bool two_opt_star_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator);
+bool node_shift(int* route, int length, double& fitv, const Case& instance, Evaluator& evaluator);
 void moveItoJ(int* route, int a, int b);
-void node_shift_for_individual(Individual& individual, Case& instance);
+void node_shift_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator);
+bool or_opt_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator, ImprovementStrategy strategy = ImprovementStrategy::BEST_IMPROVEMENT); // intra and inter-route relocation of 1-3 customers
+bool cross_exchange_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator, int maxSegment = 3, ImprovementStrategy strategy = ImprovementStrategy::BEST_IMPROVEMENT);
+bool swap_star_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator);
+bool apply_neighborhood(Neighborhood neighborhood, Individual& individual, const Case& instance, Evaluator& evaluator, ImprovementStrategy strategy); // true if the individual has been improved
 
 // recharging optimization
-double fix_one_solution(Individual& individual, Case& instance);
-pair<double, vector<int>> insert_station_by_simple_enumeration_array(int* route, int length, Case& instance);
-pair<double, vector<int>> insert_station_by_remove_array(int* route, int length, Case& instance);
-void tryACertainNArray(int mlen, int nlen, int* chosenPos, int* bestChosenPos, double& finalfit, int curub, int* route, int length, vector<double>& accumulateDis, Case& instance);
-pair<double, vector<int>> simple_repair_target_one_station(const int* route, int length, Case& instance); // O(n) - designed for route need only one station - before using, calculate how many stations are needed,
-pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRoute, double fit, Case& instance); // O(n) - designed for simple repaired route with one station - potentially improve it
+double fix_one_solution(Individual& individual, const Case& instance, Evaluator& evaluator, RepairCache* cache = nullptr);
+pair<double, vector<int>> insert_station_by_labeling(int* route, int length, const Case& instance, Evaluator& evaluator, int maxStationsPerEdge = 1, double bound = DBL_MAX); // optimal, -1 if no plan (below bound) exists
+double insert_station_by_labeling(int* route, int length, const Case& instance, Evaluator& evaluator, vector<int>& repaired, int maxStationsPerEdge = 1, double bound = DBL_MAX); // same, into a reused buffer
+long long labeling_lookups(const int* route, int length, const Case& instance); // the lookups charged by insert_station_by_labeling for a route with a plan, one station per edge
+pair<double, vector<int>> simple_repair_target_one_station(const int* route, int length, const Case& instance, Evaluator& evaluator); // O(n) - designed for route need only one station - before using, calculate how many stations are needed,
+pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRoute, double fit, const Case& instance, Evaluator& evaluator); // O(n) - designed for simple repaired route with one station - potentially improve it
 
 // Refine
-pair<vector<int>, double> insert_station_by_enumeration(vector<int>& route, Case& instance);
-void tryACertainN(int mlen, int nlen, int* chosenSta, int* chosenPos, vector<int>& finalRoute, double& finalfit, int curub, vector<int>& route, vector<double>& accumulateDis, Case& instance);
+double refine_individual(Individual& individual, const Case& instance, Evaluator& evaluator); // final recharging pass on a repaired individual, returns its fitness
+double refine_charge(const Individual& individual, const Case& instance); // the most evaluations refine_individual can charge for the individual
 
 // GA operators
 vector<vector<int>> selRandom(const vector<vector<int>>& chromosomes, int k, std::default_random_engine& rng);
@@ -5,10 +5,12 @@
 #include <iostream>
 #include <thread>
 #include <cstdlib>
+#include <chrono>
 
 #include "include/case.hpp"
 #include "include/MA.hpp"
 #include "include/stats.hpp"
+#include "include/station_scan.hpp"
 
 using namespace std;
 
@@ -28,11 +30,25 @@ std::string generateStatsFilePath(const std::string& filepath) {
     return statsFilePath;
 }
 
+void print_usage(const char* program) {
+    cerr << "Usage: " << program << " <problem_instance_filename> <stop_criteria: 1 for max-evals, 2 for max-time> <multithreading: 1 for yes>"
+            " [distance_storage: 0 full double (default), 1 full float, 2 packed triangular, 3 on the fly]"
+            " [granular_k: neighbours per node for the local search, " << Case::DEFAULT_GRANULAR_K << " by default]"
+            " [threads_per_run: threads of the local search and recharging stages inside one run, 1 by default]" << endl;
+}
+
+// the memory of the individuals of one run
+size_t population_memory(const MA& ma) {
+    size_t bytes = 0;
+    for (auto& ind : ma.population) bytes += ind->memory_usage();
+    return bytes;
+}
+
 int main(int argc, char *argv[]) {
     int run;
 
     if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <problem_instance_filename> <stop_criteria: 1 for max-evals, 2 for max-time> <multithreading: 1 for yes>" << endl;
+        print_usage(argv[0]);
         return 1;
     }
 
@@ -40,22 +56,47 @@ int main(int argc, char *argv[]) {
     string filepath = DATA_PATH + filename;
     int isMaxEvals = std::stoi(argv[2]);
     int isActivateMultiThreading = std::stoi(argv[3]);
+    int storageArg = argc > 4 ? std::stoi(argv[4]) : static_cast<int>(DistanceStorage::FULL_DOUBLE);
+    if (storageArg < static_cast<int>(DistanceStorage::FULL_DOUBLE) || storageArg > static_cast<int>(DistanceStorage::ON_THE_FLY)) {
+        cerr << "Invalid distance_storage " << argv[4] << endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+    auto distanceStorage = static_cast<DistanceStorage>(storageArg);
+    int granularK = argc > 5 ? std::stoi(argv[5]) : Case::DEFAULT_GRANULAR_K;
+    int threadsPerRun = argc > 6 ? std::stoi(argv[6]) : 1;
+    if (threadsPerRun < 1) {
+        cerr << "Invalid threads_per_run " << argv[6] << endl;
+        print_usage(argv[0]);
+        return 1;
+    }
 
     std::vector<double> perfOfTrials(MAX_TRIALS);
+    // parse the instance and build its derived tables only once, all the trials share it read-only
+    std::shared_ptr<const Case> instance;
+    try {
+        instance = std::make_shared<const Case>(filepath, distanceStorage, true, granularK);
+    } catch (const std::exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    cout << instance->instanceName << ": distance table " << instance->distances.memory_usage() << " bytes (storage " << storageArg << "), station scan " << station_scan_isa() << endl;
+    size_t populationBytes = 0;
+    auto trialsStart = std::chrono::steady_clock::now();
     if (isActivateMultiThreading == 1) {
         std::vector<std::thread> threads;
 
         // Define a function to perform the threaded work
         auto thread_function = [&](int run) {
-            Case* instance = new Case(filepath, run);
             MA* ma = new MA(instance, run, isMaxEvals);
+            ma->set_thread_num(threadsPerRun);
 
             ma->run();
 
             perfOfTrials[run - 1] = ma->globalBest->get_fit();
+            if (run == 1) populationBytes = population_memory(*ma);
 
             delete ma;
-            delete instance;
         };
 
         // Launch threads
@@ -70,19 +111,21 @@ int main(int argc, char *argv[]) {
         }
     } else {
         for (run = 1; run <= MAX_TRIALS; run++) {
-            Case* instance = new Case(filepath, run);
             MA* ma = new MA(instance, run, isMaxEvals);
+            ma->set_thread_num(threadsPerRun);
 
             ma->run();
 
             perfOfTrials[run - 1] = ma->globalBest->get_fit();
+            if (run == 1) populationBytes = population_memory(*ma);
 
             delete ma;
-            delete instance;
         }
     }
+    std::chrono::duration<double> trialsTime = std::chrono::steady_clock::now() - trialsStart;
+    cout << "Population of a run: " << populationBytes << " bytes, " << MAX_TRIALS << " trials in " << trialsTime.count() << "s" << endl;
 
-    StatsInterface::stats_for_multiple_trials(generateStatsFilePath(filepath), perfOfTrials);
+    StatsInterface::stats_for_multiple_trials(generateStatsFilePath(filepath), perfOfTrials, instance->preprocessingTime);
 
     return 0;
 }
\ No newline at end of file
@@ -4,10 +4,9 @@
 
 #include "../include/MA.hpp"
 
-MA::MA(Case* instance, int seed, int isMaxEvals, int popSize, double eliteRatio, double immigrantRatio, double crossoverProb,
-       double mutationProb, double mutationIndProb, int tournamentSize) {
+MA::MA(shared_ptr<const Case> instance, int seed, int isMaxEvals, int popSize, double eliteRatio, double immigrantRatio, double crossoverProb,
+       double mutationProb, double mutationIndProb, int tournamentSize) : instance(instance), evaluator(instance) {
     // init parameters
-    this->instance = instance;
     this->randomEngine = std::default_random_engine(seed);
     this->seed = seed;
     this->isMaxEvals = isMaxEvals;
@@ -23,9 +22,12 @@ MA::MA(Case* instance, int seed, int isMaxEvals, int popSize, double eliteRatio,
     this->mutationProb = mutationIndProb;
     this->mutationIndProb = mutationIndProb;
     this->tournamentSize = tournamentSize;
+    this->localSearchNeighborhoods = {Neighborhood::TWO_OPT, Neighborhood::TWO_OPT_STAR, Neighborhood::NODE_SHIFT, Neighborhood::RELOCATE};
+    this->localSearchStrategy = ImprovementStrategy::BEST_IMPROVEMENT;
+    this->splitMethod = SplitMethod::LINEAR;
 
     this->routeCapacity = this->instance->vehicleNumber * 3;
-    this->nodeCapacity = this->instance->customerNumber + 1;
+    this->nodeCapacity = this->instance->maxRouteLength;
     this->gen = 0;
     this->gammaL = 1.2;
     this->gammaR = 0.8;
@@ -33,6 +35,11 @@ MA::MA(Case* instance, int seed, int isMaxEvals, int popSize, double eliteRatio,
     this->r = 0.0;
 }
 
+void MA::set_thread_num(int threadNum) {
+    if (threadNum < 1) throw runtime_error("MA: the number of threads must be at least 1, got " + to_string(threadNum));
+    this->pool = threadNum > 1 ? make_unique<ThreadPool>(threadNum) : nullptr;
+}
+
 MA::~MA() {
     iterBest.reset();
     globalBest.reset();
@@ -53,6 +60,7 @@ void MA::run() {
             duration = std::chrono::high_resolution_clock::now() - start;
             flush_row_into_evol_log();
         }
+        refine_individual(*globalBest, *instance, evaluator);
         close_log_for_evolution();
         save_log_for_solution();
     } else {
@@ -68,15 +76,17 @@ void MA::run() {
             duration = std::chrono::high_resolution_clock::now() - start;
             flush_row_into_evol_log();
         }
+        refine_individual(*globalBest, *instance, evaluator);
         close_log_for_evolution();
         save_log_for_solution();
     }
 }
 
-// stop criterion: max evals
+// stop criterion: max evals, keeping enough of them for the final refine_individual of globalBest
 bool MA::termination_criteria_1() const {
     bool flag;
-    if (instance->get_evals() >= instance->maxEvals)
+    const double refineCharge = globalBest != nullptr ? refine_charge(*globalBest, *instance) : 0.0;
+    if (evaluator.get_evals() + refineCharge >= instance->maxEvals)
         flag = true;
     else
         flag = false;
@@ -99,16 +109,16 @@ void MA::pop_init_with_clustering() {
     for (int i = 0; i < popSize; ++i) {
         vector<vector<int>> routes = routes_constructor_with_hien_method(*instance, randomEngine);
         population.push_back(std::make_shared<Individual>(routeCapacity, nodeCapacity, routes,
-                                                          instance->fitness_evaluation(routes),
+                                                          evaluator.fitness_evaluation(routes),
                                                           instance->compute_demand_sum(routes)));
     }
 }
 
 void MA::pop_init_with_order_split() {
     for (int i = 0; i < popSize; ++i) {
-        vector<vector<int>> routes = routes_constructor_with_split(*instance, randomEngine);
+        vector<vector<int>> routes = routes_constructor_with_split(*instance, evaluator, randomEngine, splitMethod);
         population.push_back(std::make_shared<Individual>(routeCapacity, nodeCapacity, routes,
-                                                          instance->fitness_evaluation(routes),
+                                                          evaluator.fitness_evaluation(routes),
                                                           instance->compute_demand_sum(routes)));
     }
 }
@@ -117,11 +127,26 @@ void MA::pop_init_with_direct_encoding() {
     for (int i = 0; i < popSize; ++i) {
         vector<vector<int>> routes = routes_construct_with_direct_encoding(*instance, randomEngine);
         population.push_back(std::make_shared<Individual>(routeCapacity, nodeCapacity, routes,
-                                                          instance->fitness_evaluation(routes),
+                                                          evaluator.fitness_evaluation(routes),
                                                           instance->compute_demand_sum(routes)));
     }
 }
 
+void MA::local_search(Individual& ind, Evaluator& runEvaluator) {
+    for (Neighborhood neighborhood : localSearchNeighborhoods) {
+        apply_neighborhood(neighborhood, ind, *instance, runEvaluator, localSearchStrategy);
+    }
+}
+
+// SplitMix64 over (seed, generation, task): independent streams, reproducible from the run seed alone
+std::default_random_engine MA::task_random_engine(int seed, int gen, int task) {
+    uint64_t z = (static_cast<uint64_t>(static_cast<uint32_t>(seed)) << 32 | static_cast<uint32_t>(gen)) * 0x9e3779b97f4a7c15ULL + static_cast<uint64_t>(task);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return std::default_random_engine(static_cast<unsigned>(z % 2147483646ULL + 1)); // minstd needs a non-zero seed below its modulus
+}
+
 vector<double> MA::get_fitness_vector_from_group(const vector<shared_ptr<Individual>>& group) {
     std::vector<double> ans;
     ans.reserve(group.size());  // Reserve space to avoid unnecessary reallocation
@@ -133,6 +158,13 @@ vector<double> MA::get_fitness_vector_from_group(const vector<shared_ptr<Individ
     return ans;
 }
 
+void MA::get_fitness_vector_from_group(const vector<shared_ptr<Individual>>& group, vector<double>& fitness) {
+    fitness.clear();
+    for (const auto& ind : group) {
+        fitness.push_back(ind->get_fit());
+    }
+}
+
 void MA::open_log_for_evolution() {
     string directoryPath = "../" + statsPath + "/" + instance->instanceName + "/" + to_string(seed);
     create_directories_if_not_exists(directoryPath);
@@ -143,17 +175,18 @@ void MA::open_log_for_evolution() {
                     "offspring_size,S_min_fit,S_avg_fit,S_max_fit,S_std_fit,"
                     "upper_pop_size,S1_min_fit,S1_avg_fit,S1_max_fit,S1_std_fit,"
                     "lower_pop_size,S3_min_fit,S3_avg_fit,S3_max_fit,S3_std_fit,S3_infeasible_size,"
-                    "evaluations,progress,duration\n";
+                    "evaluations,progress,duration,repair_cache_hits,repair_cache_hit_rate\n";
 }
 
 void MA::flush_row_into_evol_log() {
-    double evals_used = instance->get_evals();
+    double evals_used = evaluator.get_evals();
     double progress = evals_used/instance->maxEvals;
     ossRowEvol << gen << "," << population.size() << ","
                << S_stats.size << "," << S_stats.min << "," << S_stats.avg << "," << S_stats.max << "," << S_stats.std << ","
                << S1_stats.size << "," << S1_stats.min << "," << S1_stats.avg << "," << S1_stats.max << "," << S1_stats.std << ","
                << S3_stats.size << "," << S3_stats.min << "," << S3_stats.avg << "," << S3_stats.max << "," << S3_stats.std << "," << S3_stats.dumbSize << ","
-               << evals_used << "," << progress << "," << duration.count() << "\n";
+               << evals_used << "," << progress << "," << duration.count() << ","
+               << repairCache.get_hits() << "," << repairCache.hit_rate() << "\n";
 }
 
 void MA::close_log_for_evolution() {
@@ -183,14 +216,34 @@ void MA::initialize_heuristic() {
     std::vector<int> emptyVector1D;
     iterBest = make_unique<Individual>(routeCapacity, nodeCapacity, emptyVector2D, INFEASIBLE, emptyVector1D);
     globalBest = make_unique<Individual>(routeCapacity, nodeCapacity, emptyVector2D, INFEASIBLE, emptyVector1D);
+
+    // a repaired tour has at most one station per edge: 1 + 2 * (customers + routes) nodes
+    const size_t tourCapacity = 1 + 2 * static_cast<size_t>(instance->customerNumber + routeCapacity);
+    for (auto& ind : population) ind->tour.reserve(tourCapacity);
+    iterBest->tour.reserve(tourCapacity);
+    globalBest->tour.reserve(tourCapacity);
+    S1.reserve(popSize);
+    S2.reserve(popSize);
+    S3.reserve(popSize);
+    fitness.reserve(popSize);
+    improvements.reserve(popSize);
+    increases.reserve(popSize);
+    P.reserve(delta + 1);
+    matings.reserve(popSize);
+    taskEvaluators.reserve(popSize);
+    for (auto* rows : {&promisingSeqs, &averageSeqs, &chromosomes}) {
+        rows->resize(popSize); // at most popSize chromosomes of each kind
+        for (auto& row : *rows) row.reserve(instance->customerNumber);
+    }
 }
 
 void MA::run_heuristic() {
     gen++;
 
-    S_stats = calculate_population_metrics(get_fitness_vector_from_group(population));
+    get_fitness_vector_from_group(population, fitness);
+    S_stats = calculate_population_metrics(fitness);
 
-    vector<shared_ptr<Individual>> S1 = population;
+    S1 = population;
     double v1 = 0;
     double v2;
     shared_ptr<Individual> talentedInd = select_best_individual(population);
@@ -198,9 +251,7 @@ void MA::run_heuristic() {
         // when the generations are greater than the threshold, part of the upper-level sub-solutions S1 will be selected for local search
         double old_fit = talentedInd->get_fit();
 
-        two_opt_for_individual(*talentedInd, *instance);
-        two_opt_star_for_individual(*talentedInd, *instance);
-        node_shift_for_individual(*talentedInd, *instance);
+        local_search(*talentedInd, evaluator);
 
         double new_fit = talentedInd->get_fit();
         v1 = old_fit - new_fit;
@@ -224,31 +275,34 @@ void MA::run_heuristic() {
 
     // make local search on S1
     v2 = 0;
-    for(auto& ind : S1) {
-        double old_fit = ind->get_fit();
-        two_opt_for_individual(*ind, *instance); // 2-opt
-        two_opt_star_for_individual(*ind, *instance);
-        node_shift_for_individual(*ind, *instance);
-        if (v2 < old_fit - ind->get_fit())
-            v2 = old_fit - ind->get_fit();
+    improvements.assign(S1.size(), 0.0);
+    for_each_task(static_cast<int>(S1.size()), [&](int i, Evaluator& taskEvaluator) {
+        double old_fit = S1[i]->get_fit();
+        local_search(*S1[i], taskEvaluator);
+        improvements[i] = old_fit - S1[i]->get_fit();
+    });
+    for (double improvement : improvements) {
+        if (v2 < improvement)
+            v2 = improvement;
     }
     v2 = (v1 > v2) ? v1 : v2;
     P.push_back(v2);
-    if (P.size() > delta)  P.pop_front();
+    if (P.size() > delta)  P.erase(P.begin());
     if (gen > delta) S1.push_back(talentedInd); //  *** switch off ***
 
 
-    S1_stats = calculate_population_metrics(get_fitness_vector_from_group(S1));
+    get_fitness_vector_from_group(S1, fitness);
+    S1_stats = calculate_population_metrics(fitness);
 
     // Current S1 has been selected and local search.
     // Pick a portion of the upper sub-solutions to go for recharging process, by the difference between before and after charging of the best solution in S1
-    vector<shared_ptr<Individual>> S2 = S1;
+    S2 = S1;
     double v3;
     shared_ptr<Individual> outstandingUpper = select_best_individual(S1);
     if (gen > 0) { // Switch = off False
         // 开关 此处只是设计了一个总是为真的虚拟条件，需要具体实现
         double old_fit = outstandingUpper->get_fit(); // fitness without recharging f
-        double new_fit = fix_one_solution(*outstandingUpper, *instance); // // fitness with recharging F
+        double new_fit = fix_one_solution(*outstandingUpper, *instance, evaluator, &repairCache); // // fitness with recharging F
         v3 = new_fit - old_fit;
         if (r > v3) r = v3 * gammaR;
 
@@ -266,121 +320,98 @@ void MA::run_heuristic() {
     }
 
     // Current S2 has been selected and ready for recharging, make recharging on S2
-    vector<shared_ptr<Individual>> S3;
+    S3.clear();
     S3.push_back(outstandingUpper); //  *** switch off ***
-    for (auto& ind:S2) {
-        double old_fit = ind->get_fit();
-        fix_one_solution(*ind, *instance);
-        double new_fit = ind->get_fit();
-        S3.push_back(ind);
-        if (v3 > new_fit - old_fit)
-            v3 = new_fit - old_fit;
+    increases.assign(S2.size(), 0.0);
+    for_each_task(static_cast<int>(S2.size()), [&](int i, Evaluator& taskEvaluator) {
+        double old_fit = S2[i]->get_fit();
+        fix_one_solution(*S2[i], *instance, taskEvaluator, &repairCache);
+        increases[i] = S2[i]->get_fit() - old_fit;
+    });
+    for (int i = 0; i < static_cast<int>(S2.size()); ++i) {
+        S3.push_back(S2[i]);
+        if (v3 > increases[i])
+            v3 = increases[i];
     }
     if (r == 0 || r > v3) {
         r = v3;
     }
 
-    S3_stats = calculate_population_metrics(get_fitness_vector_from_group(S3));
+    get_fitness_vector_from_group(S3, fitness);
+    S3_stats = calculate_population_metrics(fitness);
 
 
     // statistics
-    iterBest = make_unique<Individual>(*select_best_individual(S3));
+    *iterBest = *select_best_individual(S3);
     if (globalBest->get_fit() > iterBest->get_fit()) {
-        globalBest = make_unique<Individual>(*iterBest);
+        *globalBest = *iterBest;
     }
 
 
     // Selection
-    vector<vector<int>> promising_seqs;
-    promising_seqs.reserve(S3.size());
+    promisingNum = 0;
     for(auto& sol : S3) {
-        promising_seqs.push_back(sol->get_chromosome()); // encoding
+        sol->get_chromosome(promisingSeqs[promisingNum++]); // encoding
     }
 
-    vector<vector<int>> average_seqs;
+    averageNum = 0;
     for(auto& sol : population) {
         // judge whether sol in S3 or not
         auto it = std::find(S3.begin(), S3.end(), sol);
         if (it != S3.end()) continue;
-        average_seqs.push_back(sol->get_chromosome()); // encoding
+        sol->get_chromosome(averageSeqs[averageNum++]); // encoding
     }
 
 
-    vector<vector<int>> chromosomes;
-    if (promising_seqs.size() == 1) {
-        vector<int> father = promising_seqs[0];
-        // 90% - elite x non-elites
-        for (int i = 0; i < int (0.45 * popSize); ++i) {
-            vector<int> _father(father);
-            vector<int> mother = selRandom(average_seqs, 1, randomEngine)[0];
-            cxPartiallyMatched(_father, mother, randomEngine);
-            chromosomes.push_back(_father);
-            chromosomes.push_back(mother);
-        }
-        // 9%  - elite x immigrants
-        for (int i = 0; i < int(0.05 * popSize); ++i) {
-            vector<int> _father(father);
-            vector<int> mother(instance->customers);
-            shuffle(mother.begin(), mother.end(), randomEngine);
-            cxPartiallyMatched(_father, mother, randomEngine);
-            chromosomes.push_back(_father);
-            chromosomes.push_back(mother);
-        }
-//        chromosomes.pop_back();
-        // free 1 space  - best ind
+    // the matings, each one a task with its own random stream: parent choice, crossover and mutation do not depend on
+    // the number of threads nor on the order in which the tasks run
+    if (promisingNum == 1) {
+        // 90% - elite x non-elites, 9%  - elite x immigrants, free 1 space  - best ind
+        matings.assign(int (0.45 * popSize), PROMISING_X_AVERAGE);
+        matings.insert(matings.end(), int(0.05 * popSize), PROMISING_X_IMMIGRANT);
     } else {
-        // part of elites x elites
-        int num_promising_seqs = promising_seqs.size();
+        // part of elites x elites, then elites x non-elites for the rest of the population
+        int num_promising_seqs = promisingNum;
         int loop_num = int(num_promising_seqs / 2.0) <= (popSize/2) ? int(num_promising_seqs / 2.0) : int(popSize/4);
-        for (int i = 0; i < loop_num; ++i) {
-            vector<vector<int>> parents = selRandom(promising_seqs, 2, randomEngine);
-            cxPartiallyMatched(parents[0], parents[1], randomEngine);
-            chromosomes.push_back(parents[0]);
-            chromosomes.push_back(parents[1]);
-        }
-        // portion of elites x non-elites
-        int num_promising_x_average = popSize - chromosomes.size();
-        for (int i = 0; i < int(num_promising_x_average / 2.0); ++i) {
-            vector<int> parent1 = selRandom(promising_seqs, 1, randomEngine)[0];
-            vector<int> parent2 = selRandom(average_seqs, 1, randomEngine)[0];
-            cxPartiallyMatched(parent1, parent2, randomEngine);
-            chromosomes.push_back(parent1);
-            chromosomes.push_back(parent2);
-        }
+        matings.assign(loop_num, PROMISING_X_PROMISING);
+        int num_promising_x_average = popSize - 2 * loop_num;
+        matings.insert(matings.end(), int(num_promising_x_average / 2.0), PROMISING_X_AVERAGE);
     }
 
-    for (auto& chromosome: chromosomes) {
-        if (uniformRealDis(randomEngine) < mutationProb) {
-            mutShuffleIndexes(chromosome, mutationIndProb, randomEngine);
+    for_each_task(static_cast<int>(matings.size()), [&](int i, Evaluator&) {
+        std::default_random_engine rng = task_random_engine(seed, gen, i);
+        auto selRandomIndex = [&](int count) { return uniform_int_distribution<size_t>(0, count - 1)(rng); }; // as selRandom
+        vector<int>& parent1 = chromosomes[2 * i];
+        vector<int>& parent2 = chromosomes[2 * i + 1];
+        parent1 = promisingSeqs[selRandomIndex(promisingNum)];
+        if (matings[i] == PROMISING_X_AVERAGE) {
+            parent2 = averageSeqs[selRandomIndex(averageNum)];
+        } else if (matings[i] == PROMISING_X_IMMIGRANT) {
+            parent2 = instance->customers;
+            shuffle(parent2.begin(), parent2.end(), rng);
+        } else {
+            parent2 = promisingSeqs[selRandomIndex(promisingNum)];
         }
-    }
+        cxPartiallyMatched(parent1, parent2, rng);
+        uniform_real_distribution<double> mutationDis(0.0, 1.0);
+        for (auto* chromosome : {&parent1, &parent2}) {
+            if (mutationDis(rng) < mutationProb) {
+                mutShuffleIndexes(*chromosome, mutationIndProb, rng);
+            }
+        }
+    });
 
-    // destroy all the individual objects
     S3.clear();
     S2.clear();
     S1.clear();
-    population.clear();
-    population.shrink_to_fit();
 
 
-    // update population
-    population.reserve(popSize);
-    population.push_back(make_shared<Individual>(*iterBest));
-    for (int i = 0; i < popSize - 1; ++i) {
-        vector<int> a_giant_tour = {instance->depot};
+    // update population: the popSize individuals are allocated once in initialize_heuristic and refilled in place
+    *population[0] = *iterBest;
+    for_each_task(popSize - 1, [&](int i, Evaluator& taskEvaluator) {
+        thread_local vector<int> a_giant_tour;
+        a_giant_tour.assign(1, instance->depot);
         a_giant_tour.insert(a_giant_tour.end(), chromosomes[i].begin(), chromosomes[i].end());
-
-        vector<vector<int>> dumb_routes = prins_split(a_giant_tour, *instance);
-
-        for (auto& route : dumb_routes) {
-            route.insert(route.begin(), instance->depot);
-            route.push_back(instance->depot);
-        }
-
-        population.push_back(make_shared<Individual>(routeCapacity, nodeCapacity, dumb_routes,
-                                                     instance->fitness_evaluation(dumb_routes),
-                                                     instance->compute_demand_sum(dumb_routes))
-                                                     );
-    }
+        decode_giant_tour(splitMethod, a_giant_tour, *instance, taskEvaluator, *population[i + 1], &repairCache);
+    });
 }
-
@@ -3,121 +3,214 @@
 //
 
 #include "../include/case.hpp"
+#include "../include/instance_cache.hpp"
+#include "../include/station_scan.hpp"
 
 const int Case::MAX_EVALUATION_FACTOR = 25000;
+const int Case::DEFAULT_GRANULAR_K = 40;
+
+namespace {
+    string_view trim(string_view text) {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == string_view::npos) return {};
+        size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    // Line cursor over an in-memory .evrp file, it keeps the line number for the error messages
+    class LineReader {
+    public:
+        LineReader(const char* first, const char* last, const string& filepath) : cursor(first), last(last), filepath(filepath) {}
+
+        bool next(string_view& line) {
+            if (cursor >= last) return false;
+            const char* end = static_cast<const char*>(memchr(cursor, '\n', last - cursor));
+            if (end == nullptr) end = last;
+            line = string_view(cursor, end - cursor);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            cursor = end < last ? end + 1 : last;
+            lineNumber++;
+            return true;
+        }
+
+        bool next_non_empty(string_view& line) {
+            while (next(line)) {
+                if (!trim(line).empty()) return true;
+            }
+            return false;
+        }
+
+        template <typename T>
+        T parse_token(const char*& first, const char* end) const {
+            while (first < end && (*first == ' ' || *first == '\t')) first++;
+            T value{};
+            auto [ptr, ec] = from_chars(first, end, value);
+            if (ec != errc() || ptr == first) fail("expected a number, got \"" + string(trim(string_view(first, end - first))) + "\"");
+            first = ptr;
+            return value;
+        }
+
+        void expect_end(const char* first, const char* end) const {
+            string_view rest = trim(string_view(first, end - first));
+            if (!rest.empty()) fail("unexpected trailing \"" + string(rest) + "\"");
+        }
+
+        template <typename T>
+        T parse_value(string_view text) const {
+            const char* first = text.data();
+            const char* end = text.data() + text.size();
+            T value = parse_token<T>(first, end);
+            expect_end(first, end);
+            return value;
+        }
 
-Case::Case(const string& filepath, int id) {
-    this->ID = id;
+        [[noreturn]] void fail(const string& reason) const {
+            throw runtime_error(filepath + ":" + to_string(lineNumber) + ": " + reason);
+        }
+
+    private:
+        const char* cursor;
+        const char* last;
+        const string& filepath;
+        int lineNumber = 0;
+    };
+}
+
+Case::Case(const string& filepath, DistanceStorage distanceStorage, bool useCache, int granularK) {
+    auto start = std::chrono::steady_clock::now();
+    this->distanceStorage = distanceStorage;
+    this->granularK = granularK;
     size_t lastSeparatorPos = filepath.find_last_of('/');
     this->fileName = filepath.substr(lastSeparatorPos + 1);
     size_t lastDot = this->fileName.find_last_of('.');
     this->instanceName = this->fileName.substr(0, lastDot);
 
-    read_problem(filepath);
-}
-
-Case::~Case() {
-    for (int i = 0; i < actualProblemSize; i++) {
-        delete[] this->distances[i];
+    // a valid binary cache (same file content, same format) replaces both the parsing and the precomputation
+    if (!useCache || !InstanceCache::load(*this, filepath)) {
+        read_problem(filepath);
+        init_problem_variables();
+        init_derived_tables();
+        if (useCache) InstanceCache::save(*this, filepath);
     }
-    delete[] this->distances;
-    for (int i = 0; i < depotNumber + customerNumber; i++) {
-        delete[] this->bestStation[i];
-    }
-    delete[] this->bestStation;
+    init_neighbor_lists();
+    init_station_distances();
+    this->preprocessingTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
+// The whole file is mapped and tokenized in place with std::from_chars: no per-line string, no stream.
+// Malformed input raises a runtime_error "file:line: reason".
 void Case::read_problem(const string& filepath) {
-    stringstream ss;
+    MappedFile file(filepath);
+    if (file.data() == nullptr) throw runtime_error(filepath + ": cannot read the instance file");
+    LineReader reader(file.data(), file.data() + file.size(), filepath);
+
     this->depotNumber = 1;
     this->depot = 0;
-    ifstream infile(filepath.c_str());
-    char line[250];
-    while (infile.getline(line, 249)) {
-        string templine(line);
-        if (templine.find("DIMENSION:") != string::npos) {
-            string substr = templine.substr(templine.find(':') + 1);
-            ss << substr;
-            ss >> this->customerNumber;
-            ss.clear();
-            this->customerNumber--;
-        }
-        else if (templine.find("STATIONS:") != string::npos) {
-            string substr = templine.substr(templine.find(':') + 1);
-            ss << substr;
-            ss >> this->stationNumber;
-            ss.clear();
-        }
-        else if (templine.find("VEHICLES:") != string::npos) {
-            string substr = templine.substr(templine.find(':') + 1);
-            ss << substr;
-            ss >> this->vehicleNumber;
-            ss.clear();
-        }
-        else if (templine.find("CAPACITY:") != string::npos && templine.find("ENERGY") == string::npos) {
-            string substr = templine.substr(templine.find(':') + 1);
-            ss << substr;
-            ss >> this->maxC;
-            ss.clear();
-        }
-        else if (templine.find("ENERGY_CAPACITY:") != string::npos) {
-            string substr = templine.substr(templine.find(':') + 1);
-            ss << substr;
-            ss >> this->maxQ;
-            ss.clear();
+    this->optimum = 0;
+    int dimension = -1;
+    this->stationNumber = -1;
+    this->vehicleNumber = -1;
+    this->maxC = -1;
+    this->maxQ = -1;
+    this->conR = -1;
+    bool hasCoordinates = false;
+    bool hasDemands = false;
+
+    string_view line;
+    while (reader.next_non_empty(line)) { // whitespace-only lines are skipped between sections as within them
+        size_t colon = line.find(':');
+        if (colon != string_view::npos) {
+            string_view key = trim(line.substr(0, colon));
+            string_view value = line.substr(colon + 1);
+            if (key == "DIMENSION") dimension = reader.parse_value<int>(value);
+            else if (key == "STATIONS") this->stationNumber = reader.parse_value<int>(value);
+            else if (key == "VEHICLES") this->vehicleNumber = reader.parse_value<int>(value);
+            else if (key == "CAPACITY") this->maxC = reader.parse_value<int>(value);
+            else if (key == "ENERGY_CAPACITY") this->maxQ = reader.parse_value<double>(value);
+            else if (key == "ENERGY_CONSUMPTION") this->conR = reader.parse_value<double>(value);
+            else if (key == "OPTIMAL_VALUE") this->optimum = reader.parse_value<double>(value);
+            continue; // NAME, COMMENT, TYPE, EDGE_WEIGHT_FORMAT, ...
         }
-        else if (templine.find("ENERGY_CONSUMPTION:") != string::npos) {
-            string substr = templine.substr(templine.find(':') + 1);
-            ss << substr;
-            ss >> this->conR;
-            ss.clear();
-        }
-        else if (templine.find("OPTIMAL_VALUE:") != string::npos) {
-            string substr = templine.substr(templine.find(':') + 1);
-            ss << substr;
-            ss >> this->optimum;
-            ss.clear();
-        }
-        else if (templine.find("NODE_COORD_SECTION") != string::npos) {
+
+        string_view section = trim(line);
+        if (section == "NODE_COORD_SECTION") {
+            if (dimension < 2 || stationNumber < 0) reader.fail("NODE_COORD_SECTION must come after DIMENSION and STATIONS");
+            this->customerNumber = dimension - 1;
             this->actualProblemSize = depotNumber + customerNumber + stationNumber;
+            this->positions.assign(actualProblemSize, make_pair(0.0, 0.0));
+            vector<bool> seen(actualProblemSize, false);
             for (int i = 0; i < actualProblemSize; i++) {
-                positions.push_back(make_pair(0, 0));
-            }
-            for (int i = 0; i < actualProblemSize; i++) {
-                infile.getline(line, 249);
-                templine = line;
-                ss << templine;
-                int ind;
-                double x, y;
-                ss >> ind >> x >> y;
-                ss.clear();
-                positions[ind - 1].first = x;
-                positions[ind - 1].second = y;
+                if (!reader.next_non_empty(line)) reader.fail("NODE_COORD_SECTION ends after " + to_string(i) + " of " + to_string(actualProblemSize) + " nodes");
+                const char* cursor = line.data();
+                const char* last = line.data() + line.size();
+                int ind = reader.parse_token<int>(cursor, last);
+                double x = reader.parse_token<double>(cursor, last);
+                double y = reader.parse_token<double>(cursor, last);
+                reader.expect_end(cursor, last);
+                if (ind < 1 || ind > actualProblemSize || seen[ind - 1]) reader.fail("invalid or repeated node id " + to_string(ind));
+                seen[ind - 1] = true;
+                positions[ind - 1] = make_pair(x, y);
             }
+            hasCoordinates = true;
         }
-        else if (templine.find("DEMAND_SECTION") != string::npos) {
-            int totalNumber = depotNumber + customerNumber;
-            for (int i = 0; i < totalNumber; i++) {
-                demand.push_back(0);
-            }
+        else if (section == "DEMAND_SECTION") {
+            if (dimension < 2) reader.fail("DEMAND_SECTION must come after DIMENSION");
+            int totalNumber = dimension;
+            this->demand.assign(totalNumber, 0);
+            vector<bool> seen(totalNumber, false);
             for (int i = 0; i < totalNumber; i++) {
-                infile.getline(line, 249);
-                templine = line;
-                ss << templine;
-                int ind;
-                int c;
-                ss >> ind >> c;
-                ss.clear();
+                if (!reader.next_non_empty(line)) reader.fail("DEMAND_SECTION ends after " + to_string(i) + " of " + to_string(totalNumber) + " nodes");
+                const char* cursor = line.data();
+                const char* last = line.data() + line.size();
+                int ind = reader.parse_token<int>(cursor, last);
+                int c = reader.parse_token<int>(cursor, last);
+                reader.expect_end(cursor, last);
+                if (ind < 1 || ind > totalNumber || seen[ind - 1]) reader.fail("invalid or repeated node id " + to_string(ind));
+                if (c < 0) reader.fail("negative demand");
+                seen[ind - 1] = true;
                 demand[ind - 1] = c;
                 if (c == 0) {
                     depot = ind - 1;
                 }
             }
+            hasDemands = true;
+        }
+        else if (section == "STATIONS_COORD_SECTION") {
+            if (dimension < 2 || stationNumber < 0) reader.fail("STATIONS_COORD_SECTION must come after DIMENSION and STATIONS");
+            for (int i = 0; i < stationNumber; i++) {
+                if (!reader.next_non_empty(line)) reader.fail("STATIONS_COORD_SECTION ends after " + to_string(i) + " of " + to_string(stationNumber) + " stations");
+                const char* cursor = line.data();
+                const char* last = line.data() + line.size();
+                int ind = reader.parse_token<int>(cursor, last);
+                reader.expect_end(cursor, last);
+                if (ind <= dimension || ind > dimension + stationNumber) reader.fail("station id " + to_string(ind) + " is not in (DIMENSION, DIMENSION + STATIONS]");
+            }
+        }
+        else if (section == "DEPOT_SECTION") {
+            // the depot is identified by its zero demand, the section is only skipped up to its -1 terminator
+            while (reader.next_non_empty(line) && trim(line) != "-1") {}
+        }
+        else if (section == "EOF") {
+            break;
+        }
+        else {
+            reader.fail("unexpected line \"" + string(section) + "\"");
         }
     }
-    infile.close();
 
-    // processing variables
+    if (dimension < 0) reader.fail("missing DIMENSION");
+    if (stationNumber < 0) reader.fail("missing STATIONS");
+    if (vehicleNumber < 0) reader.fail("missing VEHICLES");
+    if (maxC < 0) reader.fail("missing CAPACITY");
+    if (maxQ < 0) reader.fail("missing ENERGY_CAPACITY");
+    if (conR <= 0) reader.fail("missing or non-positive ENERGY_CONSUMPTION");
+    if (!hasCoordinates) reader.fail("missing NODE_COORD_SECTION");
+    if (!hasDemands) reader.fail("missing DEMAND_SECTION");
+}
+
+void Case::init_problem_variables() {
+    customers.clear();
+    stations.clear();
     for (int i = 1; i < depotNumber + customerNumber; ++i) {
         customers.push_back(i);
     }
@@ -133,29 +226,20 @@ void Case::read_problem(const string& filepath) {
         this->totalDem += e;
     }
 
-    this->distances = generate_2D_matrix_double(actualProblemSize, actualProblemSize);
-    int i, j;
-    for (i = 0; i < actualProblemSize; i++) {
-        for (j = 0; j < actualProblemSize; j++) {
-            distances[i][j] = euclidean_distance(i, j);
-        }
-    }
-
-    this->bestStation = new int* [depotNumber + customerNumber];
-    for (int i = 0; i < depotNumber + customerNumber; i++) {
-        this->bestStation[i] = new int[depotNumber + customerNumber];
-        memset(this->bestStation[i], 0, sizeof(int)* (depotNumber + customerNumber));
+    // a capacity-feasible route serves at most as many customers as the smallest demands that fit together in maxC
+    vector<int> customerDemands;
+    customerDemands.reserve(customers.size());
+    for (int customer : customers) {
+        customerDemands.push_back(demand[customer]);
     }
-    for (int i = 0; i < depotNumber + customerNumber - 1; i++) {
-        for (int j = i + 1; j < depotNumber + customerNumber; j++) {
-            this->bestStation[i][j] = this->bestStation[j][i] = find_best_station(i, j);
-        }
+    sort(customerDemands.begin(), customerDemands.end());
+    int load = 0;
+    int maxCustomers = 0;
+    while (maxCustomers < customerNumber && load + customerDemands[maxCustomers] <= maxC) {
+        load += customerDemands[maxCustomers++];
     }
+    this->maxRouteLength = maxCustomers + 2;
 
-    init_customer_clusters_map();
-    init_customer_nearest_station_map();
-
-    this->evals = 0.0;
     this->maxEvals = actualProblemSize * MAX_EVALUATION_FACTOR;
     if (customerNumber <= 100) {
         maxExecTime = int (1 * (actualProblemSize / 100.0) * 60 * 60);
@@ -164,34 +248,130 @@ void Case::read_problem(const string& filepath) {
     } else {
         maxExecTime = int (3 * (actualProblemSize / 100.0) * 60 * 60);
     }
+}
 
+void Case::init_derived_tables() {
+    this->distances = DistanceMatrix(positions, distanceStorage);
+
+    ThreadPool pool; // the derived tables below are O(N^2 S) and O(N^2 log N), spread them over all the cores
+    init_best_station(pool);
+    init_feasible_station_lists(pool);
+    init_customer_clusters_map(pool);
+    init_customer_nearest_station_map();
 }
 
 
-double Case::euclidean_distance(int i, int j) {
-    double xd, yd;
-    double r = 0.0;
-    xd = positions[i].first - positions[j].first;
-    yd = positions[i].second - positions[j].second;
-    r = sqrt(xd * xd + yd * yd);
-    return r;
+double Case::euclidean_distance(int i, int j) const {
+    return DistanceMatrix::euclidean(positions[i], positions[j]);
 }
 
-void Case::init_customer_clusters_map() {
-    for (int node : customers) {
-        vector<int> other_customers;
+// Same result as calling find_best_station(i, j) for every pair, but the scan runs station by station over
+// a station-major slice of the distances, so the inner loop is a branch-free, vectorizable sweep over contiguous memory.
+void Case::init_best_station(ThreadPool& pool) {
+    const int n = depotNumber + customerNumber;
+    this->bestStation = Matrix<int>(n, n);
+
+    Matrix<double> stationSlice(stationNumber, n); // stationSlice[s][j] = d(stations[s], j)
+    for (int s = 0; s < stationNumber; ++s) {
+        for (int j = 0; j < n; ++j) {
+            stationSlice[s][j] = distances(stations[s], j);
+        }
+    }
+
+    pool.parallel_for(0, n - 1, [&](int i) {
+        vector<double> bestDis(n, DBL_MAX);
+        int* best = bestStation[i];
+        for (int j = i + 1; j < n; ++j) {
+            best[j] = -1;
+        }
+        for (int s = 0; s < stationNumber; ++s) {
+            const double* row = stationSlice[s];
+            const double fromDis = row[i];
+            const int station = stations[s];
+            for (int j = i + 1; j < n; ++j) {
+                double dis = fromDis + row[j];
+                bool better = dis < bestDis[j];
+                bestDis[j] = better ? dis : bestDis[j];
+                best[j] = better ? station : best[j];
+            }
+        }
+        for (int j = i + 1; j < n; ++j) {
+            bestStation[j][i] = best[j];
+        }
+    }, 8);
+}
+
+void Case::init_feasible_station_lists(ThreadPool& pool) {
+    const int n = depotNumber + customerNumber;
+    this->feasibleStationStart = Matrix<int>();
+    this->feasibleStations = Matrix<uint16_t>();
+    if (distanceStorage != DistanceStorage::FULL_DOUBLE || stationNumber > UINT16_MAX) return;
+
+    vector<vector<uint16_t>> rowSlots(n);
+    vector<vector<int>> rowLengths(n, vector<int>(n));
+    pool.parallel_for(0, n, [&](int from) {
+        vector<int> order(stationNumber);
+        vector<double> cost(stationNumber);
+        for (int to = 0; to < n; ++to) {
+            int num = 0;
+            for (int s = 0; s < stationNumber; ++s) {
+                if (distances(to, stations[s]) < maxDis) {
+                    order[num++] = s;
+                    cost[s] = distances(from, stations[s]) + distances(to, stations[s]);
+                }
+            }
+            sort(order.begin(), order.begin() + num, [&](int a, int b) {
+                return cost[a] < cost[b] || (cost[a] == cost[b] && a < b); // the scan keeps the lowest station on ties
+            });
+            double nearest = DBL_MAX;
+            int length = 0;
+            for (int k = 0; k < num; ++k) {
+                double fromDis = distances(from, stations[order[k]]);
+                if (fromDis < nearest) {
+                    nearest = fromDis;
+                    rowSlots[from].push_back(static_cast<uint16_t>(order[k]));
+                    length++;
+                }
+            }
+            rowLengths[from][to] = length;
+        }
+    }, 4);
+
+    size_t total = 0;
+    for (auto& slots : rowSlots) total += slots.size();
+    if (total > INT_MAX) return;
+    this->feasibleStationStart = Matrix<int>(n, n + 1);
+    this->feasibleStations = Matrix<uint16_t>(1, static_cast<int>(total));
+    int offset = 0;
+    for (int from = 0; from < n; ++from) {
+        int* start = feasibleStationStart[from];
+        for (int to = 0; to < n; ++to) {
+            start[to] = offset;
+            offset += rowLengths[from][to];
+        }
+        start[n] = offset;
+        copy(rowSlots[from].begin(), rowSlots[from].end(), feasibleStations[0] + start[0]);
+    }
+}
+
+void Case::init_customer_clusters_map(ThreadPool& pool) {
+    this->customerClusters = Matrix<int>(depotNumber + customerNumber, customerNumber - 1);
+    pool.parallel_for(0, static_cast<int>(customers.size()), [&](int k) {
+        int node = customers[k];
+        vector<double> dis(actualProblemSize);
+        int* other_customers = customerClusters[node];
+        int num = 0;
         for (int x : customers) {
             if (x != node) {
-                other_customers.push_back(x);
+                other_customers[num++] = x;
+                dis[x] = distances(node, x);
             }
         }
 
-        sort(other_customers.begin(), other_customers.end(), [&](int i, int j) {
-            return distances[node][i]  < distances[node][j];
+        sort(other_customers, other_customers + num, [&](int i, int j) {
+            return dis[i] < dis[j];
         });
-
-        customerClustersMap[node] = other_customers;
-    }
+    }, 4);
 }
 
 void Case::init_customer_nearest_station_map() {
@@ -199,7 +379,7 @@ void Case::init_customer_nearest_station_map() {
         int nearestStation = -1;
         double minDis = DBL_MAX;
         for (int j = customerNumber + 1; j < actualProblemSize; ++j) {
-            double dis = distances[i][j];
+            double dis = distances(i, j);
             if (minDis > dis) {
                 nearestStation = j;
                 minDis = dis;
@@ -209,61 +389,71 @@ void Case::init_customer_nearest_station_map() {
     }
 }
 
-double **Case::generate_2D_matrix_double(int n, int m) {
-    double **matrix;
+// Granular neighbourhoods (Toth & Vigo, 2003): a customer keeps its granularK nearest nodes among the depot and the other
+// customers, the depot keeps its granularK nearest customers. Customer rows are cut from customerClusters, so this is O(N k).
+void Case::init_neighbor_lists() {
+    const int n = depotNumber + customerNumber;
+    const int k = max(0, min(granularK, customerNumber)); // every node has exactly customerNumber candidates
+    this->granularK = k;
+    neighborStart.assign(actualProblemSize + 1, 0);
+    neighbors.resize(static_cast<size_t>(n) * k);
+
+    for (int i = 0; i < actualProblemSize; ++i) {
+        neighborStart[i + 1] = neighborStart[i] + (i < n ? k : 0);
+    }
 
-    matrix = new double *[n];
-    for (int i = 0; i < n; i++) {
-        matrix[i] = new double[m];
+    int* row = neighbors.data() + neighborStart[depot];
+    vector<int> byDepotDistance(customers);
+    partial_sort(byDepotDistance.begin(), byDepotDistance.begin() + k, byDepotDistance.end(), [&](int a, int b) {
+        return distances(depot, a) < distances(depot, b);
+    });
+    copy(byDepotDistance.begin(), byDepotDistance.begin() + k, row);
+
+    for (int customer : customers) {
+        row = neighbors.data() + neighborStart[customer];
+        ConstSpan<int> cluster = get_customer_cluster(customer);
+        const double depotDis = distances(customer, depot);
+        bool depotPlaced = false;
+        for (int num = 0, next = 0; num < k; ++num) {
+            if (!depotPlaced && (next == cluster.size() || depotDis <= distances(customer, cluster[next]))) {
+                row[num] = depot;
+                depotPlaced = true;
+            } else {
+                row[num] = cluster[next++];
+            }
+        }
     }
-    //initialize the 2-d array
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < m; j++) {
-            matrix[i][j] = 0.0;
+}
+
+// The station scans read two rows of this slice, two contiguous runs of S doubles, instead of 2 S scattered lookups.
+void Case::init_station_distances() {
+    this->stationDistances = Matrix<double>(actualProblemSize, stationNumber);
+    for (int i = 0; i < actualProblemSize; ++i) {
+        double* row = stationDistances[i];
+        for (int s = 0; s < stationNumber; ++s) {
+            row[s] = distances(i, stations[s]);
         }
     }
-    return matrix;
 }
 
 int Case::get_customer_demand(int customer) const {
     return demand[customer];
 }
 
-double Case::get_distance(int from, int to) {
-    //adds partial evaluation to the overall fitness evaluation count
-    //It can be used when local search is used and a whole evaluation is not necessary
-    evals += (1.0 / actualProblemSize);
-
-    return distances[from][to];
-}
-
-double Case::get_evals() const {
-    return evals;
-}
-
-double Case::fitness_evaluation(const vector<vector<int>>& routes) {
-    double tour_length = 0.0;
-    for (auto& route : routes) {
-        for (int j = 0; j < route.size() - 1; ++j) {
-            tour_length += distances[route[j]][route[j + 1]];
-        }
-    }
-
-    evals++;
-
-    return tour_length;
+ConstSpan<int> Case::get_customer_cluster(int customer) const {
+    return {customerClusters[customer], customerNumber - 1};
 }
 
 double Case::fitness_evaluation(const vector<int>& route) const {
     double tour_length = 0.0;
     for (int j = 0; j < route.size() - 1; ++j) {
-        tour_length += distances[route[j]][route[j + 1]];
+        tour_length += distances(route[j], route[j + 1]);
     }
 
     return tour_length;
 }
 
-vector<int> Case::compute_demand_sum(const vector<vector<int>>& routes) {
+vector<int> Case::compute_demand_sum(const vector<vector<int>>& routes) const {
     vector<int> demand_sum;
     for (auto & route : routes) {
         int temp = 0;
@@ -277,53 +467,34 @@ vector<int> Case::compute_demand_sum(const vector<vector<int>>& routes) {
 }
 
 int Case::find_best_station(int from, int to) const {
-    int theStation = -1;
-    double bigDis = DBL_MAX;
-
-    for (int i = customerNumber + 1 ; i < actualProblemSize; ++i) {
-        double dis = distances[from][i] + distances[to][i];
-
-        if (bigDis > dis && from != i && to != i) {
-            theStation = i;
-            bigDis = dis;
-        }
-    }
+    const int firstStation = depotNumber + customerNumber;
+    int slot = station_scan({stationDistances[from], stationDistances[to], stationNumber, true, INFINITY, INFINITY,
+                             from >= firstStation ? from - firstStation : -1, to >= firstStation ? to - firstStation : -1});
 
-    return theStation;
+    return slot < 0 ? -1 : stations[slot];
 }
 
 int Case::find_best_station_feasible(int from, int to, double max_dis) const {
-    int theStation = -1;
-    double bigDis = DBL_MAX;
-
-    for (int i = customerNumber + 1; i < actualProblemSize; ++i) {
-        if (distances[from][i] < max_dis &&
-            bigDis > distances[from][i]  + distances[to][i]  &&
-            from != i && to != i &&
-            distances[i][to] < maxDis) {
-
-            theStation = i;
-            bigDis = distances[from][i] + distances[to][i];
+    const int firstStation = depotNumber + customerNumber;
+    if (from < firstStation && to < firstStation && feasibleStationStart.get_rows() > 0) {
+        const double* fromDis = stationDistances[from];
+        const uint16_t* slots = feasibleStations[0];
+        for (int k = feasibleStationStart[from][to], end = feasibleStationStart[from][to + 1]; k < end; ++k) {
+            if (fromDis[slots[k]] < max_dis) return stations[slots[k]];
         }
+        return -1;
     }
+    int slot = station_scan({stationDistances[from], stationDistances[to], stationNumber, true, max_dis, maxDis,
+                             from >= firstStation ? from - firstStation : -1, to >= firstStation ? to - firstStation : -1});
 
-    return theStation;
+    return slot < 0 ? -1 : stations[slot];
 }
 
-int Case::find_nearest_station_to_y_feasible(int x, int y, double max_dis) {
-    int targetedStation = -1;
-    double minDis = DBL_MAX;
-
-    for (int s = customerNumber + 1; s < actualProblemSize; ++s) {
-        double x2station = get_distance(x, s);
-        double station2y = get_distance(s, y);
-        if (x2station <= max_dis && station2y < minDis) {
-            targetedStation = s;
-            minDis = station2y;
-        }
-    }
+int Case::find_nearest_station_to_y_feasible(int x, int y, double max_dis) const {
+    // d(x, s) <= max_dis, i.e. d(x, s) < the next double above max_dis
+    int slot = station_scan({stationDistances[x], stationDistances[y], stationNumber, false, nextafter(max_dis, INFINITY), INFINITY, -1, -1});
 
-    return targetedStation;
+    return slot < 0 ? -1 : stations[slot];
 }
 
 bool Case::is_charging_station(int node) const {
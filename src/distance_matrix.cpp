@@ -0,0 +1,110 @@
+#include "../include/distance_matrix.hpp"
+
+
+double DistanceMatrix::euclidean(const pair<double, double>& a, const pair<double, double>& b) {
+    double xd = a.first - b.first;
+    double yd = a.second - b.second;
+    return sqrt(xd * xd + yd * yd);
+}
+
+DistanceMatrix::DistanceMatrix(const vector<pair<double, double>>& positions, DistanceStorage storage) {
+    this->storage = storage;
+    this->size = static_cast<int>(positions.size());
+
+    switch (storage) {
+        case DistanceStorage::FULL_DOUBLE:
+            fullDouble = Matrix<double>(size, size);
+            for (int i = 0; i < size; ++i) {
+                for (int j = i + 1; j < size; ++j) {
+                    fullDouble[i][j] = fullDouble[j][i] = euclidean(positions[i], positions[j]);
+                }
+            }
+            break;
+        case DistanceStorage::FULL_FLOAT:
+            fullFloat = Matrix<float>(size, size);
+            for (int i = 0; i < size; ++i) {
+                for (int j = i + 1; j < size; ++j) {
+                    fullFloat[i][j] = fullFloat[j][i] = static_cast<float>(euclidean(positions[i], positions[j]));
+                }
+            }
+            break;
+        case DistanceStorage::PACKED_TRIANGULAR:
+            init_packed_row_start();
+            packedStorage.resize(static_cast<size_t>(size) * (size + 1) / 2);
+            for (int i = 0; i < size; ++i) {
+                for (int j = i; j < size; ++j) {
+                    packedStorage[packedRowStart[i] + j] = euclidean(positions[i], positions[j]);
+                }
+            }
+            packed = packedStorage.data();
+            break;
+        case DistanceStorage::ON_THE_FLY:
+            init_coordinates(positions);
+            break;
+    }
+}
+
+DistanceMatrix::DistanceMatrix(const vector<pair<double, double>>& positions, DistanceStorage storage, const void* payload) {
+    this->storage = storage;
+    this->size = static_cast<int>(positions.size());
+
+    switch (storage) {
+        case DistanceStorage::FULL_DOUBLE:
+            fullDouble = Matrix<double>(static_cast<const double*>(payload), size, size);
+            break;
+        case DistanceStorage::FULL_FLOAT:
+            fullFloat = Matrix<float>(static_cast<const float*>(payload), size, size);
+            break;
+        case DistanceStorage::PACKED_TRIANGULAR:
+            init_packed_row_start();
+            packed = static_cast<const double*>(payload);
+            break;
+        case DistanceStorage::ON_THE_FLY:
+            init_coordinates(positions);
+            break;
+    }
+}
+
+void DistanceMatrix::init_packed_row_start() {
+    packedRowStart.resize(size);
+    for (int i = 0; i < size; ++i) {
+        // row i holds d(i, i..size-1), so it starts right after the (size - k) entries of every row k < i
+        packedRowStart[i] = static_cast<size_t>(i) * size - static_cast<size_t>(i) * (i - 1) / 2 - i;
+    }
+}
+
+void DistanceMatrix::init_coordinates(const vector<pair<double, double>>& positions) {
+    xs.resize(size);
+    ys.resize(size);
+    for (int i = 0; i < size; ++i) {
+        xs[i] = positions[i].first;
+        ys[i] = positions[i].second;
+    }
+}
+
+const void* DistanceMatrix::payload() const {
+    switch (storage) {
+        case DistanceStorage::FULL_DOUBLE: return fullDouble.data();
+        case DistanceStorage::FULL_FLOAT: return fullFloat.data();
+        case DistanceStorage::PACKED_TRIANGULAR: return packed;
+        default: return nullptr;
+    }
+}
+
+size_t DistanceMatrix::payload_size(DistanceStorage storage, int size) {
+    switch (storage) {
+        case DistanceStorage::FULL_DOUBLE: return static_cast<size_t>(size) * Matrix<double>::stride_of(size) * sizeof(double);
+        case DistanceStorage::FULL_FLOAT: return static_cast<size_t>(size) * Matrix<float>::stride_of(size) * sizeof(float);
+        case DistanceStorage::PACKED_TRIANGULAR: return static_cast<size_t>(size) * (size + 1) / 2 * sizeof(double);
+        default: return 0;
+    }
+}
+
+size_t DistanceMatrix::payload_size() const {
+    return payload_size(storage, size);
+}
+
+size_t DistanceMatrix::memory_usage() const {
+    return payload_size() + packedRowStart.capacity() * sizeof(size_t)
+           + (xs.capacity() + ys.capacity()) * sizeof(double);
+}
@@ -0,0 +1,43 @@
+#include "../include/evaluator.hpp"
+
+
+Evaluator::Evaluator(shared_ptr<const Case> instance) {
+    this->instance = std::move(instance);
+    this->evals = 0.0;
+}
+
+double Evaluator::fitness_evaluation(const vector<vector<int>>& routes) {
+    double tour_length = 0.0;
+    for (auto& route : routes) {
+        for (int j = 0; j < route.size() - 1; ++j) {
+            tour_length += instance->distances(route[j], route[j + 1]);
+        }
+    }
+
+    evals++;
+
+    return tour_length;
+}
+
+double Evaluator::fitness_evaluation(int* const* routes, const int* nodeNum, int routeNum) {
+    double tour_length = 0.0;
+    for (int i = 0; i < routeNum; ++i) {
+        for (int j = 0; j < nodeNum[i] - 1; ++j) {
+            tour_length += instance->distances(routes[i][j], routes[i][j + 1]);
+        }
+    }
+
+    evals++;
+
+    return tour_length;
+}
+
+int Evaluator::find_nearest_station_to_y_feasible(int x, int y, double max_dis) {
+    charge_partial_evaluations(2LL * instance->stationNumber); // d(x, s) and d(s, y) for every station
+
+    return instance->find_nearest_station_to_y_feasible(x, y, max_dis);
+}
+
+double Evaluator::get_evals() const {
+    return evals;
+}
@@ -4,81 +4,112 @@
 
 #include "../include/individual.hpp"
 
-const int Individual::TOUR_SIZE = 1500;
+size_t Individual::arena_size(int route_cap, int node_cap) {
+    return sizeof(int*) * route_cap + sizeof(int) * (3 * static_cast<size_t>(route_cap) + static_cast<size_t>(route_cap) * node_cap);
+}
 
-Individual::Individual(const Individual& ind) {
-    this->route_cap = ind.route_cap;
-    this->node_cap = ind.node_cap;
+void Individual::allocate(int route_cap, int node_cap) {
+    this->route_cap = route_cap;
+    this->node_cap = node_cap;
+    this->arena = new char[arena_size(route_cap, node_cap)];
+    this->routes = reinterpret_cast<int**>(arena);
+    this->node_num = reinterpret_cast<int*>(arena + sizeof(int*) * route_cap);
+    this->demand_sum = this->node_num + route_cap;
+    this->route_flags = this->demand_sum + route_cap;
+    this->slots = this->route_flags + route_cap;
+}
+
+void Individual::copy_from(const Individual& ind) {
+    memcpy(this->arena, ind.arena, arena_size(route_cap, node_cap));
+    for (int i = 0; i < route_cap; ++i) {
+        this->routes[i] = this->slots + (ind.routes[i] - ind.slots);
+    }
     this->route_num = ind.route_num;
     this->fit = ind.fit;
-    this->routes = new int *[ind.route_cap];
-    for (int i = 0; i < ind.route_cap; ++i) {
-        this->routes[i] = new int[ind.node_cap];
-        memcpy(this->routes[i], ind.routes[i], sizeof(int) * ind.node_cap);
-    }
-    this->node_num = new int[ind.route_cap];
-    memcpy(this->node_num, ind.node_num, sizeof(int) * ind.route_cap);
-    this->demand_sum = new int[ind.route_cap];
-    memcpy(this->demand_sum, ind.demand_sum, sizeof(int) * ind.route_cap);
-    this->tour = new int [TOUR_SIZE];
-    memcpy(this->tour, ind.tour, sizeof(int) * (ind.steps));
+    this->tour = ind.tour; // keeps the capacity already reserved by this individual when it is large enough
     this->steps = ind.steps;
 }
 
+Individual::Individual(const Individual& ind) {
+    allocate(ind.route_cap, ind.node_cap);
+    copy_from(ind);
+}
+
 Individual::Individual(int route_cap, int node_cap) {
-    this->route_cap = route_cap;
-    this->node_cap = node_cap;
-    this->routes = new int *[route_cap];
+    allocate(route_cap, node_cap);
+    memset(this->arena, 0, arena_size(route_cap, node_cap));
     for (int i = 0; i < route_cap; ++i) {
-        this->routes[i] = new int[node_cap];
-        memset(this->routes[i], 0, sizeof(int) * node_cap);
+        this->routes[i] = this->slots + static_cast<size_t>(i) * node_cap;
     }
     this->route_num = 0;
-    this->node_num = new int[route_cap];
-    memset(this->node_num, 0, sizeof(int) * route_cap);
-    this->demand_sum = new int [route_cap];
-    memset(this->demand_sum, 0, sizeof(int) * route_cap);
     this->fit = 0;
-    this->tour = new int[TOUR_SIZE];
-    memset(this->tour, 0, sizeof(int) * TOUR_SIZE);
     this->steps = 0;
 }
 
 Individual::Individual(int route_cap, int node_cap, const vector<vector<int>>& _routes, double fit, const vector<int>& demand_sum)
 :Individual(route_cap, node_cap) {
-    this->fit = fit;
-    this->route_num = _routes.size();
-    for (int i = 0; i < this->route_num; ++i) {
-        this->node_num[i] = _routes[i].size();
-        for (int j = 0; j < this->node_num[i]; ++j) {
-            this->routes[i][j] = _routes[i][j];
-        }
-    }
-    for (int i = 0; i < demand_sum.size(); ++i) {
-        this->demand_sum[i] = demand_sum[i];
-    }
+    assign(_routes, fit, demand_sum);
 }
 
 Individual::~Individual() {
-    for (int i = 0; i < this->route_cap; ++i) {
-        delete[] this->routes[i];
+    delete[] this->arena;
+}
+
+Individual& Individual::operator=(const Individual& ind) {
+    if (this == &ind) return *this;
+    if (this->route_cap != ind.route_cap || this->node_cap != ind.node_cap) {
+        delete[] this->arena;
+        allocate(ind.route_cap, ind.node_cap);
     }
-    delete[] this->routes;
-    delete[] this->node_num;
-    delete[] this->demand_sum;
-    delete[] this->tour;
+    copy_from(ind);
+    return *this;
+}
+
+size_t Individual::memory_usage() const {
+    return sizeof(Individual) + arena_size(route_cap, node_cap) + tour.capacity() * sizeof(int);
 }
 
 
 void Individual::reset() {
     memset(this->node_num, 0, sizeof(int) * this->route_cap);
     memset(this->demand_sum, 0, sizeof(int) * this->route_cap);
+    memset(this->route_flags, 0, sizeof(int) * this->route_cap);
     this->fit = 0;
     this->route_num = 0;
-    memset(this->tour, 0, sizeof(int) * TOUR_SIZE);
+    this->tour.clear(); // the capacity is kept for the next set_tour
     this->steps = 0;
 }
 
+void Individual::assign(const vector<vector<int>>& _routes, double _fit, const vector<int>& _demand_sum) {
+    if (static_cast<int>(_routes.size()) > route_cap) throw runtime_error("Individual: " + to_string(_routes.size()) + " routes exceed the route capacity " + to_string(route_cap));
+    reset();
+    this->fit = _fit;
+    this->route_num = _routes.size();
+    for (int i = 0; i < this->route_num; ++i) {
+        if (static_cast<int>(_routes[i].size()) > node_cap) throw runtime_error("Individual: a route of " + to_string(_routes[i].size()) + " nodes exceeds the node capacity " + to_string(node_cap));
+        this->node_num[i] = _routes[i].size();
+        for (int j = 0; j < this->node_num[i]; ++j) {
+            this->routes[i][j] = _routes[i][j];
+        }
+    }
+    for (int i = 0; i < _demand_sum.size(); ++i) {
+        this->demand_sum[i] = _demand_sum[i];
+    }
+}
+
+void Individual::append_route(int depot, const int* customers, int count, int demand) {
+    if (this->route_num >= route_cap) throw runtime_error("Individual: " + to_string(this->route_num + 1) + " routes exceed the route capacity " + to_string(route_cap));
+    if (count + 2 > node_cap) throw runtime_error("Individual: a route of " + to_string(count + 2) + " nodes exceeds the node capacity " + to_string(node_cap));
+    int* route = this->routes[this->route_num];
+    route[0] = depot;
+    memcpy(route + 1, customers, sizeof(int) * count);
+    route[count + 1] = depot;
+    this->node_num[this->route_num] = count + 2;
+    this->demand_sum[this->route_num] = demand;
+    this->route_flags[this->route_num] = 0;
+    this->route_num++;
+}
+
 vector<vector<int>> Individual::get_routes() const {
     vector<vector<int>> all_routes(route_num);
 
@@ -95,12 +126,15 @@ vector<vector<int>> Individual::get_routes() const {
 
 vector<int> Individual::get_chromosome() const {
     vector<int> chromosome; // num of customers
+    get_chromosome(chromosome);
+    return chromosome;
+}
+
+void Individual::get_chromosome(vector<int>& chromosome) const {
+    chromosome.clear();
     for (int i = 0; i < route_num; ++i) {
-        for (int j = 1; j < node_num[i] - 1; ++j) {
-            chromosome.push_back(routes[i][j]);
-        }
+        if (node_num[i] > 2) chromosome.insert(chromosome.end(), routes[i] + 1, routes[i] + node_num[i] - 1);
     }
-    return chromosome;
 }
 
 
@@ -118,15 +152,23 @@ void Individual::set_routes(const vector<vector<int>>& _routes) const {
         for (int j = 0; j < _routes[i].size(); ++j) {
             this->routes[i][j] = _routes[i][j];
         }
+        this->route_flags[i] = 0;
     }
 }
 
 
 pair<int*, int> Individual::get_tour() {
-    return make_pair(this->tour, this->steps);
+    return make_pair(this->tour.data(), this->steps);
 }
 
 void Individual::set_tour(const vector<vector<int>>& repaired_routes) {
+    size_t length = 1; // every route but its returning depot, then the final depot
+    for (const auto& route : repaired_routes) {
+        if (route.size() < 2) throw runtime_error("Individual: a repaired route must start and end at the depot");
+        length += route.size() - 1;
+    }
+    this->tour.resize(length); // only reallocates when the tour outgrows every previous one
+
     int index = 0;
     for (const auto& route : repaired_routes) {
         for (int i = 0; i < route.size() - 1; ++i) {
@@ -137,6 +179,11 @@ void Individual::set_tour(const vector<vector<int>>& repaired_routes) {
     this->steps = index;
 }
 
+void Individual::set_tour(const int* repaired_tour, int length) {
+    this->tour.assign(repaired_tour, repaired_tour + length); // only reallocates when the tour outgrows every previous one
+    this->steps = length;
+}
+
 
 std::ostream& operator<<(std::ostream& os, const Individual& individual) {
     os << "Route Capacity: " << individual.route_cap << "\n";
@@ -0,0 +1,235 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <filesystem>
+
+#include "../include/instance_cache.hpp"
+
+const uint32_t InstanceCache::VERSION = 2;
+
+namespace {
+    const char MAGIC[8] = {'E', 'V', 'R', 'P', 'B', 'I', 'N', '\0'};
+
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t distanceStorage;
+        uint64_t sourceHash;
+        int32_t depotNumber;
+        int32_t customerNumber;
+        int32_t stationNumber;
+        int32_t vehicleNumber;
+        int32_t actualProblemSize;
+        int32_t maxC;
+        int32_t depot;
+        int32_t reserved;
+        double maxQ;
+        double conR;
+        double optimum;
+        // byte offsets of the sections, every one aligned to Matrix::ALIGNMENT
+        uint64_t positionsOffset;
+        uint64_t demandOffset;
+        uint64_t distancesOffset;
+        uint64_t distancesSize;
+        uint64_t bestStationOffset;
+        uint64_t bestStationSize;
+        uint64_t clustersOffset;
+        uint64_t clustersSize;
+        uint64_t feasibleStartOffset; // both feasible station sections are empty when the lists are not built
+        uint64_t feasibleStartSize;
+        uint64_t feasibleStationsOffset;
+        uint64_t feasibleStationsSize;
+        uint64_t feasibleStationsCount;
+        uint64_t fileSize;
+    };
+
+    uint64_t align_up(uint64_t offset) {
+        return (offset + Matrix<char>::ALIGNMENT - 1) / Matrix<char>::ALIGNMENT * Matrix<char>::ALIGNMENT;
+    }
+}
+
+
+MappedFile::MappedFile(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            this->bytes = static_cast<const char*>(addr);
+            this->length = st.st_size;
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != nullptr) {
+        munmap(const_cast<char*>(bytes), length);
+    }
+}
+
+
+string InstanceCache::cache_path(const string& filepath) {
+    return std::filesystem::path(filepath).replace_extension(".evrpbin").string();
+}
+
+uint64_t InstanceCache::hash_file(const string& filepath) {
+    MappedFile file(filepath);
+    if (file.data() == nullptr) return 0;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < file.size(); ++i) {
+        hash ^= static_cast<unsigned char>(file.data()[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool InstanceCache::load(Case& instance, const string& filepath) {
+    uint64_t sourceHash = hash_file(filepath);
+    if (sourceHash == 0) return false;
+    auto mapping = make_shared<const MappedFile>(cache_path(filepath));
+    if (mapping->size() < sizeof(CacheHeader)) return false;
+
+    CacheHeader header{};
+    memcpy(&header, mapping->data(), sizeof(CacheHeader));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.sourceHash != sourceHash || header.fileSize != mapping->size() ||
+        header.distanceStorage != static_cast<uint32_t>(instance.distanceStorage)) {
+        return false;
+    }
+
+    // the sections must have the sizes implied by the dimensions and fit in the file
+    int n = header.depotNumber + header.customerNumber;
+    auto matrix_size = [](uint64_t rows, int cols) { return rows * Matrix<int>::stride_of(cols) * sizeof(int); };
+    auto distanceStorage = static_cast<DistanceStorage>(header.distanceStorage);
+    if (header.customerNumber < 2 || header.actualProblemSize < n ||
+        header.positionsOffset + 2 * sizeof(double) * header.actualProblemSize > header.demandOffset ||
+        header.demandOffset + sizeof(int32_t) * n > header.distancesOffset ||
+        header.distancesSize != DistanceMatrix::payload_size(distanceStorage, header.actualProblemSize) ||
+        header.distancesOffset + header.distancesSize > header.bestStationOffset ||
+        header.bestStationSize != matrix_size(n, n) ||
+        header.bestStationOffset + header.bestStationSize > header.clustersOffset ||
+        header.clustersSize != matrix_size(n, header.customerNumber - 1) ||
+        header.clustersOffset + header.clustersSize > header.feasibleStartOffset ||
+        (header.feasibleStartSize != 0 && header.feasibleStartSize != matrix_size(n, n + 1)) ||
+        header.feasibleStartOffset + header.feasibleStartSize > header.feasibleStationsOffset ||
+        header.feasibleStationsCount > INT_MAX ||
+        header.feasibleStationsSize != 1ULL * Matrix<uint16_t>::stride_of(static_cast<int>(header.feasibleStationsCount)) * sizeof(uint16_t) ||
+        header.feasibleStationsOffset + header.feasibleStationsSize > header.fileSize) {
+        return false;
+    }
+    const char* base = mapping->data();
+    Matrix<int> feasibleStationStart;
+    if (header.feasibleStartSize != 0) {
+        feasibleStationStart = Matrix<int>(reinterpret_cast<const int*>(base + header.feasibleStartOffset), n, n + 1);
+        if (feasibleStationStart[n - 1][n] != static_cast<int>(header.feasibleStationsCount)) return false;
+    }
+
+    instance.depotNumber = header.depotNumber;
+    instance.customerNumber = header.customerNumber;
+    instance.stationNumber = header.stationNumber;
+    instance.vehicleNumber = header.vehicleNumber;
+    instance.actualProblemSize = header.actualProblemSize;
+    instance.maxC = header.maxC;
+    instance.depot = header.depot;
+    instance.maxQ = header.maxQ;
+    instance.conR = header.conR;
+    instance.optimum = header.optimum;
+
+    instance.positions.resize(instance.actualProblemSize);
+    const auto* coordinates = reinterpret_cast<const double*>(base + header.positionsOffset);
+    for (int i = 0; i < instance.actualProblemSize; ++i) {
+        instance.positions[i] = make_pair(coordinates[2 * i], coordinates[2 * i + 1]);
+    }
+    const auto* demands = reinterpret_cast<const int32_t*>(base + header.demandOffset);
+    instance.demand.assign(demands, demands + n);
+
+    instance.init_problem_variables();
+    instance.distances = DistanceMatrix(instance.positions, instance.distanceStorage, base + header.distancesOffset);
+    instance.bestStation = Matrix<int>(reinterpret_cast<const int*>(base + header.bestStationOffset), n, n);
+    instance.customerClusters = Matrix<int>(reinterpret_cast<const int*>(base + header.clustersOffset), n, instance.customerNumber - 1);
+    instance.feasibleStationStart = std::move(feasibleStationStart);
+    instance.feasibleStations = Matrix<uint16_t>(reinterpret_cast<const uint16_t*>(base + header.feasibleStationsOffset), 1, static_cast<int>(header.feasibleStationsCount));
+    instance.init_customer_nearest_station_map();
+    instance.cacheMapping = mapping;
+
+    return true;
+}
+
+bool InstanceCache::save(const Case& instance, const string& filepath) {
+    uint64_t sourceHash = hash_file(filepath);
+    if (sourceHash == 0) return false;
+
+    CacheHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.distanceStorage = static_cast<uint32_t>(instance.distanceStorage);
+    header.sourceHash = sourceHash;
+    header.depotNumber = instance.depotNumber;
+    header.customerNumber = instance.customerNumber;
+    header.stationNumber = instance.stationNumber;
+    header.vehicleNumber = instance.vehicleNumber;
+    header.actualProblemSize = instance.actualProblemSize;
+    header.maxC = instance.maxC;
+    header.depot = instance.depot;
+    header.maxQ = instance.maxQ;
+    header.conR = instance.conR;
+    header.optimum = instance.optimum;
+
+    vector<double> coordinates;
+    for (auto& position : instance.positions) {
+        coordinates.push_back(position.first);
+        coordinates.push_back(position.second);
+    }
+    vector<int32_t> demands(instance.demand.begin(), instance.demand.end());
+
+    header.positionsOffset = align_up(sizeof(CacheHeader));
+    header.demandOffset = align_up(header.positionsOffset + coordinates.size() * sizeof(double));
+    header.distancesOffset = align_up(header.demandOffset + demands.size() * sizeof(int32_t));
+    header.distancesSize = instance.distances.payload_size();
+    header.bestStationOffset = align_up(header.distancesOffset + header.distancesSize);
+    header.bestStationSize = instance.bestStation.memory_usage();
+    header.clustersOffset = align_up(header.bestStationOffset + header.bestStationSize);
+    header.clustersSize = instance.customerClusters.memory_usage();
+    header.feasibleStartOffset = align_up(header.clustersOffset + header.clustersSize);
+    header.feasibleStartSize = instance.feasibleStationStart.memory_usage();
+    header.feasibleStationsOffset = align_up(header.feasibleStartOffset + header.feasibleStartSize);
+    header.feasibleStationsSize = instance.feasibleStations.memory_usage();
+    header.feasibleStationsCount = instance.feasibleStations.get_cols();
+    header.fileSize = header.feasibleStationsOffset + header.feasibleStationsSize;
+
+    // write a private temporary file first, then rename it: readers never see a partially written cache
+    string path = cache_path(filepath);
+    string tempPath = path + ".tmp." + to_string(getpid());
+    ofstream out(tempPath, ios::binary | ios::trunc);
+    if (!out) return false;
+    auto write_at = [&](uint64_t offset, const void* bytes, uint64_t size) {
+        static const char zeros[Matrix<char>::ALIGNMENT] = {};
+        auto position = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<streamsize>(offset - position));
+        if (size > 0) out.write(static_cast<const char*>(bytes), static_cast<streamsize>(size));
+    };
+    write_at(0, &header, sizeof(CacheHeader));
+    write_at(header.positionsOffset, coordinates.data(), coordinates.size() * sizeof(double));
+    write_at(header.demandOffset, demands.data(), demands.size() * sizeof(int32_t));
+    write_at(header.distancesOffset, instance.distances.payload(), header.distancesSize);
+    write_at(header.bestStationOffset, instance.bestStation.data(), header.bestStationSize);
+    write_at(header.clustersOffset, instance.customerClusters.data(), header.clustersSize);
+    write_at(header.feasibleStartOffset, instance.feasibleStationStart.data(), header.feasibleStartSize);
+    write_at(header.feasibleStationsOffset, instance.feasibleStations.data(), header.feasibleStationsSize);
+    out.close();
+
+    std::error_code error;
+    if (!out) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
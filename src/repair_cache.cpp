@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "../include/repair_cache.hpp"
+
+const size_t RepairCache::DEFAULT_CAPACITY = 16384;
+
+
+RepairCache::RepairCache(size_t capacity) : capacity(max<size_t>(capacity, 1)) {
+    index.reserve(this->capacity);
+}
+
+uint64_t RepairCache::hash_route(const int* route, int length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<uint32_t>(route[i])) * 1099511628211ULL;
+    }
+    // final mix, the low bits of a multiplicative hash are weak for the bucket index
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+bool RepairCache::find(const int* route, int length, pair<double, vector<int>>& result, double& evals) {
+    uint64_t key = hash_route(route, length);
+    lock_guard<mutex> lock(mtx);
+    auto it = index.find(key);
+    if (it == index.end() || !equal(route, route + length, it->second->second.route.begin(), it->second->second.route.end())) {
+        misses++;
+        return false;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    const Entry& entry = it->second->second;
+    result.first = entry.cost;
+    result.second.assign(entry.repaired.begin(), entry.repaired.end());
+    evals = entry.evals;
+    return true;
+}
+
+void RepairCache::insert(const int* route, int length, double cost, const vector<int>& repaired, double evals) {
+    uint64_t key = hash_route(route, length);
+    lock_guard<mutex> lock(mtx);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        entries.splice(entries.begin(), entries, it->second); // same key: overwritten in place
+    } else if (entries.size() >= capacity) {
+        auto node = index.extract(entries.back().first); // the index node is re-keyed, nothing is freed or allocated
+        entries.splice(entries.begin(), entries, prev(entries.end())); // the evicted node is reused, with its buffers
+        entries.front().first = key;
+        node.key() = key;
+        node.mapped() = entries.begin();
+        index.insert(std::move(node));
+    } else {
+        entries.emplace_front();
+        entries.front().first = key;
+        index.emplace(key, entries.begin());
+    }
+    Entry& entry = entries.front().second;
+    entry.route.assign(route, route + length);
+    entry.repaired.assign(repaired.begin(), repaired.end());
+    entry.cost = cost;
+    entry.evals = evals;
+}
+
+void RepairCache::clear() {
+    lock_guard<mutex> lock(mtx);
+    entries.clear();
+    index.clear();
+    hits = 0;
+    misses = 0;
+}
+
+size_t RepairCache::size() const {
+    lock_guard<mutex> lock(mtx);
+    return entries.size();
+}
+
+long long RepairCache::get_hits() const {
+    lock_guard<mutex> lock(mtx);
+    return hits;
+}
+
+long long RepairCache::get_misses() const {
+    lock_guard<mutex> lock(mtx);
+    return misses;
+}
+
+double RepairCache::hit_rate() const {
+    lock_guard<mutex> lock(mtx);
+    return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+}
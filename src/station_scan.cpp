@@ -0,0 +1,114 @@
+#include "../include/station_scan.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+
+namespace {
+    int scalar_scan(const StationScan& scan) {
+        const double* a = scan.a;
+        const double* b = scan.b;
+        const bool keyIncludesA = scan.keyIncludesA;
+        double best = DBL_MAX;
+        int slot = -1;
+        for (int s = 0; s < scan.count; ++s) {
+            double key = keyIncludesA ? a[s] + b[s] : b[s];
+            if (key < best && a[s] < scan.limitA && b[s] < scan.limitB && s != scan.skip1 && s != scan.skip2) {
+                best = key;
+                slot = s;
+            }
+        }
+        return slot;
+    }
+}
+
+#if defined(__AVX__)
+
+// Two passes over the slice: the minimum key first, with independent accumulators and no loop-carried select,
+// then the first slot that reaches it, so that ties resolve to the lowest slot exactly like the scalar loop.
+// Below AVX_MIN_STATIONS the setup and the second pass cost more than the scalar loop saves.
+constexpr int AVX_MIN_STATIONS = 24;
+
+namespace {
+    inline double scalar_key(const StationScan& scan, int s) {
+        if (scan.a[s] < scan.limitA && scan.b[s] < scan.limitB && s != scan.skip1 && s != scan.skip2) {
+            return scan.keyIncludesA ? scan.a[s] + scan.b[s] : scan.b[s];
+        }
+        return INFINITY;
+    }
+
+    struct Lanes {
+        __m256d limitA, limitB, skip1, skip2, keyMaskA, infinity;
+        explicit Lanes(const StationScan& scan)
+            : limitA(_mm256_set1_pd(scan.limitA)), limitB(_mm256_set1_pd(scan.limitB)),
+              skip1(_mm256_set1_pd(scan.skip1)), skip2(_mm256_set1_pd(scan.skip2)),
+              keyMaskA(_mm256_castsi256_pd(_mm256_set1_epi64x(scan.keyIncludesA ? -1 : 0))), infinity(_mm256_set1_pd(INFINITY)) {}
+
+        // the key of slots s .. s+3, infinity where the slot is not admissible
+        inline __m256d key(const StationScan& scan, int s) const {
+            __m256d a = _mm256_loadu_pd(scan.a + s);
+            __m256d b = _mm256_loadu_pd(scan.b + s);
+            __m256d slot = _mm256_add_pd(_mm256_set1_pd(s), _mm256_setr_pd(0.0, 1.0, 2.0, 3.0));
+            __m256d ok = _mm256_and_pd(_mm256_cmp_pd(a, limitA, _CMP_LT_OQ), _mm256_cmp_pd(b, limitB, _CMP_LT_OQ));
+            ok = _mm256_and_pd(ok, _mm256_and_pd(_mm256_cmp_pd(slot, skip1, _CMP_NEQ_OQ), _mm256_cmp_pd(slot, skip2, _CMP_NEQ_OQ)));
+            return _mm256_blendv_pd(infinity, _mm256_add_pd(_mm256_and_pd(a, keyMaskA), b), ok);
+        }
+    };
+}
+
+int station_scan(const StationScan& scan) {
+    if (scan.count < AVX_MIN_STATIONS) return scalar_scan(scan);
+
+    const Lanes lanes(scan);
+    __m256d min0 = lanes.infinity;
+    __m256d min1 = lanes.infinity;
+    int s = 0;
+    for (; s + 8 <= scan.count; s += 8) {
+        min0 = _mm256_min_pd(min0, lanes.key(scan, s));
+        min1 = _mm256_min_pd(min1, lanes.key(scan, s + 4));
+    }
+    for (; s + 4 <= scan.count; s += 4) {
+        min0 = _mm256_min_pd(min0, lanes.key(scan, s));
+    }
+    alignas(32) double lane[4];
+    _mm256_store_pd(lane, _mm256_min_pd(min0, min1));
+    double best = min(min(lane[0], lane[1]), min(lane[2], lane[3]));
+    for (int t = s; t < scan.count; ++t) {
+        best = min(best, scalar_key(scan, t));
+    }
+    if (best >= DBL_MAX) return -1;
+
+    const __m256d target = _mm256_set1_pd(best);
+    int v = 0;
+    for (; v + 4 <= scan.count; v += 4) {
+        int hit = _mm256_movemask_pd(_mm256_cmp_pd(lanes.key(scan, v), target, _CMP_EQ_OQ));
+        if (hit != 0) return v + __builtin_ctz(hit);
+    }
+    for (; v < scan.count; ++v) {
+        if (scalar_key(scan, v) == best) return v;
+    }
+    return -1;
+}
+
+const char* station_scan_isa() {
+    return "AVX";
+}
+
+#else
+
+int station_scan(const StationScan& scan) {
+    return scalar_scan(scan);
+}
+
+const char* station_scan_isa() {
+    return "scalar";
+}
+
+#endif
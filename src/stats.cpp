@@ -8,39 +8,36 @@ const std::string StatsInterface::statsPath = "stats";
 PopulationMetrics StatsInterface::calculate_population_metrics(const std::vector<double> &data) {
     PopulationMetrics metrics;
 
-    // Filter out infeasible data
-    std::vector<double> feasibleData;
-    for (double value : data) {
-        if (value <= INFEASIBLE) {
-            feasibleData.push_back(value);
-        }
-    }
+    // Only the feasible data count, they are filtered on the fly
+    auto feasible = [](double value) { return value <= INFEASIBLE; };
+    metrics.size = std::count_if(data.begin(), data.end(), feasible);
+    metrics.dumbSize = data.size() - metrics.size;
 
-    metrics.size = feasibleData.size();
-    metrics.dumbSize = data.size() - feasibleData.size();
-
-    if (feasibleData.empty()) {
+    if (metrics.size == 0) {
         metrics.min = 0.0;
         metrics.max = 0.0;
         metrics.avg = 0.0;
         metrics.std = 0.0;
     } else {
         // Calculate min, max, mean, and standard deviation for feasible data
-        metrics.min = *std::min_element(feasibleData.begin(), feasibleData.end());
-        metrics.max = *std::max_element(feasibleData.begin(), feasibleData.end());
-
+        metrics.min = DBL_MAX;
+        metrics.max = -DBL_MAX;
         double sum = 0.0;
-        for (double value : feasibleData) {
+        for (double value : data) {
+            if (!feasible(value)) continue;
+            metrics.min = std::min(metrics.min, value);
+            metrics.max = std::max(metrics.max, value);
             sum += value;
         }
-        metrics.avg = sum / static_cast<double>(feasibleData.size());
+        metrics.avg = sum / static_cast<double>(metrics.size);
 
         double sumSquaredDiff = 0.0;
-        for (double value : feasibleData) {
+        for (double value : data) {
+            if (!feasible(value)) continue;
             double diff = value - metrics.avg;
             sumSquaredDiff += diff * diff;
         }
-        metrics.std = (feasibleData.size() == 1) ? 0.0 : std::sqrt(sumSquaredDiff / static_cast<double>(feasibleData.size() - 1));
+        metrics.std = (metrics.size == 1) ? 0.0 : std::sqrt(sumSquaredDiff / static_cast<double>(metrics.size - 1));
     }
 
     return metrics;
@@ -62,7 +59,7 @@ bool StatsInterface::create_directories_if_not_exists(const string &directoryPat
     }
 }
 
-void StatsInterface::stats_for_multiple_trials(const std::string& filePath, const std::vector<double>& data) {
+void StatsInterface::stats_for_multiple_trials(const std::string& filePath, const std::vector<double>& data, double preprocessingTime) {
     std::ofstream logStats;
 
     logStats.open(filePath);
@@ -75,6 +72,7 @@ void StatsInterface::stats_for_multiple_trials(const std::string& filePath, cons
     oss << "Mean " << metric.avg << "\t \tStd Dev " << metric.std << "\t " << endl;
     oss << "Min: " << metric.min << "\t " << endl;
     oss << "Max: " << metric.max << "\t " << endl;
+    oss << "Preprocessing time: " << setprecision(4) << preprocessingTime << "s\t " << endl;
     logStats << oss.str() << flush;
 
     logStats.close();
@@ -0,0 +1,99 @@
+#include "../include/thread_pool.hpp"
+
+
+int ThreadPool::default_thread_num() {
+    unsigned int n = thread::hardware_concurrency();
+    return n == 0 ? 1 : static_cast<int>(n);
+}
+
+ThreadPool::ThreadPool(int threadNum) {
+    for (int i = 1; i < threadNum; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    cvJob.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::get_thread_num() const {
+    return static_cast<int>(workers.size()) + 1;
+}
+
+void ThreadPool::parallel_for(int begin, int end, const function<void(int)>& body, int grain) {
+    if (begin >= end) return;
+    if (workers.empty() || end - begin <= grain) {
+        for (int i = begin; i < end; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(mtx);
+        job = &body;
+        next.store(begin);
+        jobEnd = end;
+        jobGrain = grain < 1 ? 1 : grain;
+        failure = nullptr;
+        generation++;
+    }
+    cvJob.notify_all();
+
+    drain(body);
+
+    exception_ptr error;
+    {
+        unique_lock<mutex> lock(mtx);
+        cvDone.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+        error = failure;
+        failure = nullptr;
+    }
+    if (error) rethrow_exception(error);
+}
+
+void ThreadPool::drain(const function<void(int)>& body) {
+    while (true) {
+        int first = next.fetch_add(jobGrain);
+        if (first >= jobEnd) break;
+        int last = first + jobGrain < jobEnd ? first + jobGrain : jobEnd;
+        try {
+            for (int i = first; i < last; ++i) {
+                body(i);
+            }
+        } catch (...) {
+            lock_guard<mutex> lock(mtx);
+            if (!failure) failure = current_exception();
+            next.store(jobEnd); // skip the remaining work
+        }
+    }
+}
+
+void ThreadPool::worker_loop() {
+    unsigned long long seen = 0;
+    while (true) {
+        const function<void(int)>* body;
+        {
+            unique_lock<mutex> lock(mtx);
+            cvJob.wait(lock, [&] { return stopping || (generation != seen && job != nullptr); });
+            if (stopping) return;
+            seen = generation;
+            body = job;
+            busy++;
+        }
+        drain(*body);
+        {
+            lock_guard<mutex> lock(mtx);
+            busy--;
+        }
+        cvDone.notify_all();
+    }
+}
@@ -4,8 +4,8 @@
 
 #include <algorithm>
 #include <cfloat>
+#include <climits>
 #include <list>
-#include <unordered_set>
 #include <optional>
 
 
@@ -18,7 +18,7 @@
 /****************************************************************/
 
 // Prins, C., 2004. A simple and effective evolutionary algorithm for the vehicle routing problem. Computers & operations research, 31(12), pp.1985-2002.
-vector<vector<int>> prins_split(const vector<int>& x, Case& instance) {
+vector<vector<int>> prins_split(const vector<int>& x, const Case& instance, Evaluator& evaluator) {
     int arr_length = instance.customerNumber + 1;
     int* pp = new int[arr_length];
     auto* vv = new double[arr_length];
@@ -35,11 +35,11 @@ vector<vector<int>> prins_split(const vector<int>& x, Case& instance) {
         {
             load += instance.get_customer_demand(x[j]);
             if (i == j) {
-                cost = instance.get_distance(instance.depot, x[j]) * 2;
+                cost = evaluator.get_distance(instance.depot, x[j]) * 2;
             } else {
-                cost -= instance.get_distance(x[j -1], instance.depot);
-                cost += instance.get_distance(x[j -1], x[j]);
-                cost += instance.get_distance(instance.depot, x[j]);
+                cost -= evaluator.get_distance(x[j -1], instance.depot);
+                cost += evaluator.get_distance(x[j -1], x[j]);
+                cost += evaluator.get_distance(instance.depot, x[j]);
             }
 
             if (load <= instance.maxC) {
@@ -68,6 +68,143 @@ vector<vector<int>> prins_split(const vector<int>& x, Case& instance) {
     return all_routes;
 }
 
+namespace {
+    // Per-position arrays of a giant tour x, reused by the splits of a thread. With the route x[i + 1 .. t]:
+    // cost(i, t) = potential[i] + depotTo[i + 1] + prefixDistance[t] - prefixDistance[i + 1] + toDepot[t].
+    struct SplitScratch {
+        vector<double> prefixDistance; // length of x[1 .. k] along the tour
+        vector<double> depotTo; // d(depot, x[k])
+        vector<double> toDepot; // d(x[k], depot)
+        vector<int> load; // demand of x[1 .. k]
+        vector<double> potential; // cost of the best split of x[1 .. k]
+        vector<int> pred; // x[pred[k] + 1 .. k] is the last route of that split
+        vector<int> queue; // candidate predecessors, a deque over [head, tail)
+        bool hasPlans; // ENERGY only, the recharging plans of the last routes below
+        vector<vector<int>> plan; // plan[k]: depot, x[pred[k] + 1 .. k], depot with the stations of its cheapest recharging
+        vector<double> planCost; // the length of plan[k]
+    };
+
+    SplitScratch& split_scratch(const vector<int>& x, const Case& instance, Evaluator& evaluator) {
+        thread_local SplitScratch scratch;
+        const int n = static_cast<int>(x.size()) - 1;
+        scratch.prefixDistance.resize(n + 1);
+        scratch.depotTo.resize(n + 1);
+        scratch.toDepot.resize(n + 1);
+        scratch.load.resize(n + 1);
+        scratch.potential.resize(n + 1);
+        scratch.pred.resize(n + 1);
+        scratch.queue.resize(n + 1);
+        scratch.prefixDistance[0] = scratch.prefixDistance[1] = 0;
+        scratch.load[0] = 0;
+        for (int k = 1; k <= n; ++k) {
+            scratch.depotTo[k] = evaluator.get_distance(instance.depot, x[k]);
+            scratch.toDepot[k] = evaluator.get_distance(x[k], instance.depot);
+            if (k > 1) scratch.prefixDistance[k] = scratch.prefixDistance[k - 1] + evaluator.get_distance(x[k - 1], x[k]);
+            scratch.load[k] = scratch.load[k - 1] + instance.get_customer_demand(x[k]);
+        }
+        scratch.potential[0] = 0;
+        scratch.hasPlans = false;
+        return scratch;
+    }
+
+    // the routes of the split, last route first like prins_split
+    vector<vector<int>> split_routes(const vector<int>& x, const SplitScratch& scratch) {
+        vector<vector<int>> all_routes;
+        for (int t = static_cast<int>(x.size()) - 1; t > 0; t = scratch.pred[t]) {
+            all_routes.emplace_back(x.begin() + scratch.pred[t] + 1, x.begin() + t + 1);
+        }
+        return all_routes;
+    }
+
+    // Vidal, T., 2016. Technical note: Split algorithm in O(n) for the capacitated vehicle routing problem. Computers & Operations Research, 69, pp.40-47.
+    // Same optimal split as prins_split: a predecessor i only matters through potential[i] + depotTo[i + 1] - prefixDistance[i + 1],
+    // so the queue keeps the capacity-feasible ones with that key non-decreasing, and the front is the best one.
+    // The routes are left in scratch.pred.
+    SplitScratch& solve_linear_split(const vector<int>& x, const Case& instance, Evaluator& evaluator) {
+        SplitScratch& scratch = split_scratch(x, instance, evaluator);
+        const int n = static_cast<int>(x.size()) - 1;
+        const double* D = scratch.prefixDistance.data();
+        const double* p = scratch.potential.data();
+        const int* L = scratch.load.data();
+        auto key = [&](int i) { return p[i] + scratch.depotTo[i + 1] - D[i + 1]; };
+
+        int* queue = scratch.queue.data();
+        int head = 0, tail = 0;
+        queue[tail++] = 0;
+        for (int t = 1; t <= n; ++t) {
+            while (L[t] - L[queue[head]] > instance.maxC && tail - head > 1) ++head;
+            int i = queue[head];
+            scratch.potential[t] = key(i) + D[t] + scratch.toDepot[t];
+            scratch.pred[t] = i;
+            if (t < n) {
+                while (tail > head && key(queue[tail - 1]) > key(t)) --tail;
+                queue[tail++] = t;
+            }
+        }
+        return scratch;
+    }
+}
+
+vector<vector<int>> linear_split(const vector<int>& x, const Case& instance, Evaluator& evaluator) {
+    return split_routes(x, solve_linear_split(x, instance, evaluator));
+}
+
+// Vidal (2016) with a soft capacity: cost(i, t) + penalty * max(0, load of the route - maxC). The routes may be overloaded.
+// A later predecessor has less load ahead of it, so it replaces an earlier one with a higher key; an earlier one that
+// stays better even when it pays the penalty on all the load in between makes a later one useless.
+vector<vector<int>> linear_split_soft(const vector<int>& x, const Case& instance, Evaluator& evaluator, double penalty) {
+    SplitScratch& scratch = split_scratch(x, instance, evaluator);
+    const int n = static_cast<int>(x.size()) - 1;
+    const double* D = scratch.prefixDistance.data();
+    const double* p = scratch.potential.data();
+    const int* L = scratch.load.data();
+    auto key = [&](int i) { return p[i] + scratch.depotTo[i + 1] - D[i + 1]; };
+    auto cost = [&](int i, int t) { return key(i) + D[t] + scratch.toDepot[t] + penalty * max(0, L[t] - L[i] - instance.maxC); };
+
+    int* queue = scratch.queue.data();
+    int head = 0, tail = 0;
+    queue[tail++] = 0;
+    for (int t = 1; t <= n; ++t) {
+        int i = queue[head];
+        scratch.potential[t] = cost(i, t);
+        scratch.pred[t] = i;
+        if (t < n) {
+            int back = queue[tail - 1];
+            if (key(t) <= key(back) + penalty * (L[t] - L[back])) {
+                while (tail > head && key(t) <= key(queue[tail - 1])) --tail;
+                queue[tail++] = t;
+            }
+            while (tail - head > 1 && cost(queue[head], t + 1) >= cost(queue[head + 1], t + 1)) ++head;
+        }
+    }
+    return split_routes(x, scratch);
+}
+
+vector<vector<int>> split_giant_tour(SplitMethod method, const vector<int>& x, const Case& instance, Evaluator& evaluator) {
+    if (method == SplitMethod::PRINS) return prins_split(x, instance, evaluator);
+    if (method == SplitMethod::LINEAR) return linear_split(x, instance, evaluator);
+    if (method == SplitMethod::ENERGY) return energy_split(x, instance, evaluator);
+
+    // one unit of excess load costs the range of a full battery per vehicle capacity
+    vector<vector<int>> soft_routes = linear_split_soft(x, instance, evaluator, instance.maxDis / instance.maxC);
+    vector<vector<int>> all_routes;
+    vector<int> sub_tour;
+    for (auto& route : soft_routes) {
+        int load = 0;
+        for (int customer : route) load += instance.get_customer_demand(customer);
+        if (load <= instance.maxC) {
+            all_routes.push_back(std::move(route));
+            continue;
+        }
+        sub_tour.assign(1, instance.depot);
+        sub_tour.insert(sub_tour.end(), route.begin(), route.end());
+        for (auto& sub_route : linear_split(sub_tour, instance, evaluator)) {
+            all_routes.push_back(std::move(sub_route));
+        }
+    }
+    return all_routes;
+}
+
 // Hien et al., "A greedy search based evolutionary algorithm for electric vehicle routing problem", 2023.
 vector<vector<int>> hien_clustering(const Case& instance, std::default_random_engine& rng) {
     vector<int> customers(instance.customers);
@@ -85,7 +222,7 @@ vector<vector<int>> hien_clustering(const Case& instance, std::default_random_en
         tour.push_back(anchor);
         int cap = instance.get_customer_demand(anchor);
 
-        const vector<int> &nearby_customers = instance.customerClustersMap.at(anchor);
+        ConstSpan<int> nearby_customers = instance.get_customer_cluster(anchor);
         for (int node: nearby_customers) {
             auto it = find(customers.begin(), customers.end(), node);
             if (it == customers.end()) {
@@ -118,7 +255,7 @@ void hien_balancing(vector<vector<int>>& routes, const Case& instance, std::defa
         cap1 += instance.get_customer_demand(node);
     }
 
-    for (int x : instance.customerClustersMap.at(customer)) {
+    for (int x : instance.get_customer_cluster(customer)) {
         if (find(lastRoute.begin(), lastRoute.end(), x) != lastRoute.end()) {
             continue;
         }
@@ -147,14 +284,14 @@ void hien_balancing(vector<vector<int>>& routes, const Case& instance, std::defa
     }
 }
 
-vector<vector<int>> routes_constructor_with_split(Case& instance, std::default_random_engine& rng) {
+vector<vector<int>> routes_constructor_with_split(const Case& instance, Evaluator& evaluator, std::default_random_engine& rng, SplitMethod method) {
     vector<int> a_giant_tour(instance.customers);
 
     shuffle(a_giant_tour.begin(), a_giant_tour.end(), rng);
 
     a_giant_tour.insert(a_giant_tour.begin(), instance.depot);
 
-    vector<vector<int>> all_routes = prins_split(a_giant_tour, instance);
+    vector<vector<int>> all_routes = split_giant_tour(method, a_giant_tour, instance, evaluator);
     for (auto& route : all_routes) {
         route.insert(route.begin(), 0);
         route.push_back(0);
@@ -226,216 +363,441 @@ vector<vector<int>> routes_construct_with_direct_encoding(const Case& instance,
 /*                    Local search Operators                    */
 /****************************************************************/
 
-double two_opt_for_single_route(vector<int>& route, Case& instance) {
-    bool improved = true;
-    double totalChange = 0.0;
-
-    while (improved) {
-        improved = false;
+namespace {
+// Node -> position (and route) scratch tables of the granular operators, one set per thread. An entry is only meaningful
+// for the nodes of the route(s) currently indexed, hence every lookup is checked against the route itself.
+// "mark" deduplicates the candidates of one scan: slot x has been tried in the current scan iff mark[x] == stamp.
+// "active" and "queue" hold the don't-look bits and the pending nodes of the 2-opt engine, "pairQueue", "pairQueued"
+// and "routesNear" the route-pair worklist of 2-opt* (the last two are route_cap x route_cap, row-major) and
+// "prefixLoad" its per-route prefix demands (route_cap x node_cap), "routeCopy" the route that 2-opt or 2-opt* rewrites,
+// "removalGain" the segment removal gains of Or-opt.
+struct NodeIndex {
+    vector<int> position;
+    vector<int> route;
+    vector<int> mark;
+    vector<char> active;
+    vector<int> queue;
+    vector<pair<int, int>> pairQueue;
+    vector<char> pairQueued; // all zero between two calls
+    vector<char> routesNear;
+    vector<int> prefixLoad;
+    vector<int> routeCopy;
+    vector<double> removalGain;
+    int stamp = 0;
+
+    int new_stamp() {
+        if (++stamp == INT_MAX) {
+            fill(mark.begin(), mark.end(), 0);
+            stamp = 1;
+        }
+        return stamp;
+    }
 
-        for (size_t i = 1; i < route.size() - 2; ++i) {
-            for (size_t j = i + 1; j <route.size() - 1; ++j) {
-                // Calculate the cost difference between the old route and the new route obtained by swapping edges
-                double oldCost = instance.get_distance(route[i - 1], route[i]) +
-                                 instance.get_distance(route[j], route[j + 1]);
+    bool try_once(int slot) { // true the first time "slot" is seen in the current scan
+        if (mark[slot] == stamp) return false;
+        mark[slot] = stamp;
+        return true;
+    }
+};
+
+NodeIndex& node_index(const Case& instance) {
+    thread_local NodeIndex index;
+    if (index.position.size() < static_cast<size_t>(instance.actualProblemSize)) {
+        index.position.assign(instance.actualProblemSize, 0);
+        index.route.assign(instance.actualProblemSize, -1);
+        index.active.assign(instance.actualProblemSize, 0);
+        index.mark.assign(2 * (instance.actualProblemSize + 2), 0); // two slots per route position
+    }
+    return index;
+}
+}
 
-                double newCost = instance.get_distance(route[i - 1], route[j]) +
-                                 instance.get_distance(route[i], route[j + 1]);
+// Granular 2-opt with don't-look bits. A pending node u tries every 2-opt move that links it to one of its neighbours v:
+// either (u, succ u) and (v, succ v) are replaced by (u, v) and (succ u, succ v), or (pred u, u) and (pred v, v) by
+// (u, v) and (pred u, pred v). Through the position index each delta is O(1); the best one is applied and the four nodes
+// it touched become pending again, otherwise u is switched off until a later move touches it.
+// The lookups are made on the Case and charged to the evaluator in bulk, 4 per move as in a full scan.
+double two_opt_for_single_route(vector<int>& route, const Case& instance, Evaluator& evaluator) {
+    const int length = static_cast<int>(route.size());
+    if (length < 4) return 0.0;
+
+    NodeIndex& index = node_index(instance);
+    vector<int>& position = index.position;
+    vector<int>& queue = index.queue;
+    queue.clear();
+    for (int p = 1; p < length - 1; ++p) {
+        position[route[p]] = p;
+        index.active[route[p]] = 1;
+        queue.push_back(route[p]);
+    }
+    auto activate = [&](int node) {
+        if (node != instance.depot && !index.active[node]) {
+            index.active[node] = 1;
+            queue.push_back(node);
+        }
+    };
 
-                if (newCost < oldCost) {
-                    // The cost variation should be considered
-                    reverse(route.begin() + i, route.begin() + j + 1);
-                    improved = true;
-                    totalChange += newCost - oldCost;
+    const DistanceMatrix& d = instance.distances;
+    long long lookups = 0;
+    double totalChange = 0.0;
+    // a neighbour list of the whole instance rarely meets a short route: a route of at most granularK customers is scanned whole
+    const bool scanRoute = length - 2 <= instance.granularK;
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const int u = queue[head];
+        index.active[u] = 0;
+        const int pu = position[u];
+        const double toSucc = d(u, route[pu + 1]);
+        const double toPred = d(route[pu - 1], u);
+
+        double bestDelta = -0.00000001;
+        int bestI = 0, bestJ = 0;
+        auto try_position = [&](int pv) {
+            const int v = route[pv];
+            const int a = min(pu, pv);
+            const int b = max(pu, pv);
+            if (b - a < 2) return; // adjacent nodes, (u, v) is already an edge
+            const double uv = d(u, v);
+            if (b < length - 1) { // reverse route[a + 1 .. b]
+                double delta = uv + d(route[pu + 1], route[pv + 1]) - toSucc - d(v, route[pv + 1]);
+                lookups += 4;
+                if (delta < bestDelta) {
+                    bestDelta = delta;
+                    bestI = a + 1;
+                    bestJ = b;
+                }
+            }
+            if (a > 0) { // reverse route[a .. b - 1]
+                double delta = uv + d(route[pu - 1], route[pv - 1]) - toPred - d(route[pv - 1], v);
+                lookups += 4;
+                if (delta < bestDelta) {
+                    bestDelta = delta;
+                    bestI = a;
+                    bestJ = b - 1;
+                }
+            }
+        };
+        if (scanRoute) {
+            for (int pv = 0; pv < length; ++pv) try_position(pv);
+        } else {
+            for (int v : instance.get_neighbors(u)) {
+                if (v == instance.depot) {
+                    try_position(0);
+                    try_position(length - 1);
+                } else {
+                    int p = position[v];
+                    if (p > 0 && p < length - 1 && route[p] == v) try_position(p);
                 }
             }
         }
+
+        if (bestJ > 0) {
+            reverse(route.begin() + bestI, route.begin() + bestJ + 1);
+            for (int q = bestI; q <= bestJ; ++q) {
+                position[route[q]] = q;
+            }
+            totalChange += bestDelta;
+            activate(route[bestI - 1]);
+            activate(route[bestI]);
+            activate(route[bestJ]);
+            activate(route[bestJ + 1]);
+        }
     }
+    evaluator.charge_partial_evaluations(lookups);
 
     return totalChange;
 }
 
 // Croes, Georges A. "A method for solving traveling-salesman problems." Operations research 6, no. 6 (1958): 791-812.
-bool two_opt_for_individual(Individual& individual, Case& instance) {
-    vector<vector<int>> routes = individual.get_routes();
+bool two_opt_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator) {
     double totalChange = 0;
-    for (auto& route : routes) {
-        double change = two_opt_for_single_route(route, instance);
-        totalChange += change;
+    vector<int>& route = node_index(instance).routeCopy;
+    for (int i = 0; i < individual.route_num; ++i) {
+        if (individual.is_route_done(i, Individual::TWO_OPT_DONE)) continue;
+        route.assign(individual.routes[i], individual.routes[i] + individual.node_num[i]);
+        double change = two_opt_for_single_route(route, instance, evaluator);
+        if (change != 0) {
+            memcpy(individual.routes[i], route.data(), sizeof(int) * route.size());
+            individual.mark_route_changed(i);
+            totalChange += change;
+        }
+        individual.set_route_done(i, Individual::TWO_OPT_DONE);
     }
     individual.set_fit(individual.get_fit() + totalChange);
-    individual.set_routes(routes);
 
     return totalChange != 0;
 }
 
 // Jia Ya-Hui, et al.
-bool two_opt_star_for_individual(Individual& individual, Case& instance) {
+// Granular version: for a route pair (r1, r2), a cut (n1, n2) is only evaluated when one of the two edges it creates
+// links a node of r1 to one of its neighbours in r2. The candidates come from the neighbour lists of the nodes of r1
+// and a node -> (route, position) index, and the demand prefix sums of the routes give the capacity check in O(1).
+// The prefix sums are kept for every route and only rebuilt for the two routes a move rewrites, and a move only
+// copies the route segments it displaces, so its cost depends on the route lengths, not on node_cap.
+bool two_opt_star_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator) {
     if (individual.route_num == 1) {
         return false;
     }
 
-    unordered_set<pair<int, int>, pair_hash> routepairs;
+    NodeIndex& index = node_index(instance);
+    auto index_route = [&](int r) {
+        for (int p = 1; p < individual.node_num[r] - 1; p++) {
+            index.route[individual.routes[r][p]] = r;
+            index.position[individual.routes[r][p]] = p;
+        }
+    };
+    for (int r = 0; r < individual.route_num; r++) {
+        index_route(r);
+    }
+
+    // routesNear[r * cap + s] != 0 when a customer of route r has a customer of route s among its neighbours;
+    // route pairs that are near in neither direction share no granular edge and are never queued
+    const int cap = individual.route_cap;
+    const size_t cells = static_cast<size_t>(cap) * cap;
+    if (index.pairQueued.size() < cells) {
+        index.pairQueued.resize(cells, 0);
+        index.routesNear.resize(cells);
+    }
+    char* near = index.routesNear.data();
+    auto link_route = [&](int r) {
+        char* row = near + static_cast<size_t>(r) * cap;
+        memset(row, 0, cap);
+        for (int p = 1; p < individual.node_num[r] - 1; p++) {
+            for (int neighbor : instance.get_neighbors(individual.routes[r][p])) {
+                if (neighbor != instance.depot) row[index.route[neighbor]] = 1;
+            }
+        }
+    };
+    for (int r = 0; r < individual.route_num; r++) {
+        link_route(r);
+    }
+
+    // dense FIFO of pairs (i, j), i < j, with a bitmap against duplicates; a pair whose route has been removed is dropped when popped
+    vector<pair<int, int>>& routepairs = index.pairQueue;
+    routepairs.clear();
+    auto push_pair = [&](int i, int j) {
+        size_t cell = static_cast<size_t>(i) * cap + j;
+        if (index.pairQueued[cell] || !(near[cell] || near[static_cast<size_t>(j) * cap + i])) return;
+        index.pairQueued[cell] = 1;
+        routepairs.emplace_back(i, j);
+    };
+    // two routes that have not changed since the last 2-opt* on the individual were already paired with their current content
     for (int i = 0; i < individual.route_num - 1; i++) {
         for (int j = i + 1; j < individual.route_num; j++) {
-            routepairs.insert(make_pair(i, j));
+            if (individual.is_route_done(i, Individual::TWO_OPT_STAR_DONE) && individual.is_route_done(j, Individual::TWO_OPT_STAR_DONE)) continue;
+            push_pair(i, j);
         }
     }
-    int* tempr = new int[individual.node_cap];
-    int* tempr2 = new int[individual.node_cap];
+
+    // prefix[r * node_cap + n] is the demand of routes[r][0..n]
+    const int stride = individual.node_cap;
+    if (index.prefixLoad.size() < static_cast<size_t>(cap) * stride) {
+        index.prefixLoad.resize(static_cast<size_t>(cap) * stride);
+    }
+    int* prefix = index.prefixLoad.data();
+    auto sum_route = [&](int r) {
+        int* row = prefix + static_cast<size_t>(r) * stride;
+        int sum = 0;
+        for (int n = 0; n < individual.node_num[r]; n++) {
+            sum += instance.get_customer_demand(individual.routes[r][n]);
+            row[n] = sum;
+        }
+    };
+    for (int r = 0; r < individual.route_num; r++) {
+        sum_route(r);
+    }
+
+    if (index.routeCopy.size() < static_cast<size_t>(individual.node_cap)) {
+        index.routeCopy.resize(individual.node_cap);
+    }
+    int* tempr = index.routeCopy.data();
+    int r1 = 0;
+    int r2 = 0;
+
+    // tails: r1 keeps routes[r1][0..n1] followed by routes[r2][n2+1..], r2 keeps routes[r2][0..n2] followed by routes[r1][n1+1..]
+    // otherwise: r1 gets routes[r1][0..n1] + reversed routes[r2][0..n2], r2 gets reversed routes[r1][n1+1..] + routes[r2][n2+1..]
+    auto try_move = [&](int n1, int n2, bool tails) {
+        if (n1 < 0 || n2 < 0 || n1 >= individual.node_num[r1] - 1 || n2 >= individual.node_num[r2] - 1) return false;
+        const int frdem = prefix[static_cast<size_t>(r1) * stride + n1];
+        const int srdem = prefix[static_cast<size_t>(r2) * stride + n2];
+        if (tails) {
+            if (frdem + individual.demand_sum[r2] - srdem > instance.maxC || srdem + individual.demand_sum[r1] - frdem > instance.maxC) return false;
+            double xx1 = evaluator.get_distance(individual.routes[r1][n1], individual.routes[r1][n1 + 1]) +
+                    evaluator.get_distance(individual.routes[r2][n2], individual.routes[r2][n2 + 1]);
+            double xx2 = evaluator.get_distance(individual.routes[r1][n1], individual.routes[r2][n2 + 1]) +
+                    evaluator.get_distance(individual.routes[r2][n2], individual.routes[r1][n1 + 1]);
+            double change = xx1 - xx2;
+            if (change <= 0.00000001) return false;
+
+            individual.fit -= change;
+            memcpy(tempr + n1 + 1, individual.routes[r1] + n1 + 1, sizeof(int) * (individual.node_num[r1] - n1 - 1));
+            int counter1 = n1 + 1;
+            for (int i = n2 + 1; i < individual.node_num[r2]; i++) {
+                individual.routes[r1][counter1] = individual.routes[r2][i];
+                counter1++;
+            }
+            int counter2 = n2 + 1;
+            for (int i = n1 + 1; i < individual.node_num[r1]; i++) {
+                individual.routes[r2][counter2] = tempr[i];
+                counter2++;
+            }
+            individual.node_num[r1] = counter1;
+            individual.node_num[r2] = counter2;
+            int newdemsum1 = frdem + individual.demand_sum[r2] - srdem;
+            int newdemsum2 = srdem + individual.demand_sum[r1] - frdem;
+            individual.demand_sum[r1] = newdemsum1;
+            individual.demand_sum[r2] = newdemsum2;
+        } else {
+            if (frdem + srdem > instance.maxC || individual.demand_sum[r1] - frdem + individual.demand_sum[r2] - srdem > instance.maxC) return false;
+            double xx1 = evaluator.get_distance(individual.routes[r1][n1], individual.routes[r1][n1 + 1])
+                         + evaluator.get_distance(individual.routes[r2][n2], individual.routes[r2][n2 + 1]);
+            double xx2 = evaluator.get_distance(individual.routes[r1][n1], individual.routes[r2][n2])
+                         + evaluator.get_distance(individual.routes[r1][n1 + 1], individual.routes[r2][n2 + 1]);
+            double change = xx1 - xx2;
+            if (change <= 0.00000001) return false;
+
+            individual.fit -= change;
+            const int tail1 = individual.node_num[r1] - n1 - 1;
+            memcpy(tempr, individual.routes[r1] + n1 + 1, sizeof(int) * tail1);
+            int counter1 = n1 + 1;
+            for (int i = n2; i >= 0; i--) {
+                individual.routes[r1][counter1] = individual.routes[r2][i];
+                counter1++;
+            }
+            const int tail2 = individual.node_num[r2] - n2 - 1;
+            memmove(individual.routes[r2] + tail1, individual.routes[r2] + n2 + 1, sizeof(int) * tail2);
+            for (int i = 0; i < tail1; i++) {
+                individual.routes[r2][i] = tempr[tail1 - 1 - i];
+            }
+            int counter2 = tail1 + tail2;
+            individual.node_num[r1] = counter1;
+            individual.node_num[r2] = counter2;
+
+            int newdemsum1 = frdem + srdem;
+            int newdemsum2 = individual.demand_sum[r1] + individual.demand_sum[r2] - frdem - srdem;
+            individual.demand_sum[r1] = newdemsum1;
+            individual.demand_sum[r2] = newdemsum2;
+        }
+        return true;
+    };
+
     bool updated = false;
-    bool updated2 = false;
-    while (!routepairs.empty())
+    for (size_t head = 0; head < routepairs.size(); head++)
     {
-        updated2 = false;
-        int r1 = routepairs.begin()->first;
-        int r2 = routepairs.begin()->second;
-        routepairs.erase(routepairs.begin());
-        int frdem = 0;
-        for (int n1 = 0; n1 < individual.node_num[r1] - 1; n1++) {
-            frdem += instance.get_customer_demand(individual.routes[r1][n1]);
-            int srdem = 0;
-            for (int n2 = 0; n2 < individual.node_num[r2] - 1; n2++) {
-                srdem += instance.get_customer_demand(individual.routes[r2][n2]);
-                if (frdem + individual.demand_sum[r2] - srdem <= instance.maxC && srdem + individual.demand_sum[r1] - frdem <= instance.maxC) {
-                    double xx1 = instance.get_distance(individual.routes[r1][n1], individual.routes[r1][n1 + 1]) +
-                            instance.get_distance(individual.routes[r2][n2], individual.routes[r2][n2 + 1]);
-                    double xx2 = instance.get_distance(individual.routes[r1][n1], individual.routes[r2][n2 + 1]) +
-                            instance.get_distance(individual.routes[r2][n2], individual.routes[r1][n1 + 1]);
-                    double change = xx1 - xx2;
-                    if (change > 0.00000001) {
-                        individual.fit -= change;
-                        memcpy(tempr, individual.routes[r1], sizeof(int) * individual.node_cap);
-                        int counter1 = n1 + 1;
-                        for (int i = n2 + 1; i < individual.node_num[r2]; i++) {
-                            individual.routes[r1][counter1] = individual.routes[r2][i];
-                            counter1++;
-                        }
-                        int counter2 = n2 + 1;
-                        for (int i = n1 + 1; i < individual.node_num[r1]; i++) {
-                            individual.routes[r2][counter2] = tempr[i];
-                            counter2++;
-                        }
-                        individual.node_num[r1] = counter1;
-                        individual.node_num[r2] = counter2;
-                        int newdemsum1 = frdem + individual.demand_sum[r2] - srdem;
-                        int newdemsum2 = srdem + individual.demand_sum[r1] - frdem;
-                        individual.demand_sum[r1] = newdemsum1;
-                        individual.demand_sum[r2] = newdemsum2;
-                        updated = true;
-                        updated2 = true;
-                        for (int i = 0; i < r1; i++) {
-                            routepairs.insert({i, r1});
-                        }
-                        for (int i = 0; i < r2; i++) {
-                            routepairs.insert({i, r2});
-                        }
-                        if (individual.demand_sum[r1] == 0) {
-                            int* tempp = individual.routes[r1];
-                            individual.routes[r1] = individual.routes[individual.route_num - 1];
-                            individual.routes[individual.route_num - 1] = tempp;
-                            individual.demand_sum[r1] = individual.demand_sum[individual.route_num - 1];
-                            individual.node_num[r1] = individual.node_num[individual.route_num - 1];
-                            individual.route_num--;
-                            for (int i = 0; i < individual.route_num; i++) {
-                                routepairs.erase({i, individual.route_num});
-                            }
-                        }
-                        if (individual.demand_sum[r2] == 0) {
-                            int* tempp = individual.routes[r2];
-                            individual.routes[r2] = individual.routes[individual.route_num - 1];
-                            individual.routes[individual.route_num - 1] = tempp;
-                            individual.demand_sum[r2] = individual.demand_sum[individual.route_num - 1];
-                            individual.node_num[r2] = individual.node_num[individual.route_num - 1];
-                            individual.route_num--;
-                            for (int i = 0; i < individual.route_num; i++) {
-                                routepairs.erase({i, individual.route_num});
-                            }
-                        }
-                        break;
+        r1 = routepairs[head].first;
+        r2 = routepairs[head].second;
+        index.pairQueued[static_cast<size_t>(r1) * cap + r2] = 0;
+        if (r2 >= individual.route_num) continue;
+        // both edges created by a cut at n1 start from routes[r1][n1] or routes[r1][n1 + 1], so the neighbours of these
+        // two nodes located in r2 give every candidate n2 of both move types
+        bool updated2 = false;
+        const int lastPosition2 = individual.node_num[r2] - 1;
+        for (int n1 = 0; n1 < individual.node_num[r1] - 1 && !updated2; n1++) {
+            index.new_stamp();
+            for (int side = 0; side < 2 && !updated2; side++) {
+                for (int neighbor : instance.get_neighbors(individual.routes[r1][n1 + side])) {
+                    int positions[2];
+                    int count = 0;
+                    if (neighbor == instance.depot) {
+                        positions[count++] = 0;
+                        positions[count++] = lastPosition2;
+                    } else if (index.route[neighbor] == r2 && index.position[neighbor] < lastPosition2 && individual.routes[r2][index.position[neighbor]] == neighbor) {
+                        positions[count++] = index.position[neighbor];
                     }
-                }
-                else if (frdem + srdem <= instance.maxC && individual.demand_sum[r1] - frdem + individual.demand_sum[r2] - srdem <= instance.maxC) {
-                    double xx1 = instance.get_distance(individual.routes[r1][n1], individual.routes[r1][n1 + 1])
-                                 + instance.get_distance(individual.routes[r2][n2], individual.routes[r2][n2 + 1]);
-                    double xx2 = instance.get_distance(individual.routes[r1][n1], individual.routes[r2][n2])
-                                 + instance.get_distance(individual.routes[r1][n1 + 1], individual.routes[r2][n2 + 1]);
-                    double change = xx1 - xx2;
-                    if (change > 0.00000001) {
-                        individual.fit -= change;
-                        memcpy(tempr, individual.routes[r1], sizeof(int) * individual.node_cap);
-                        int counter1 = n1 + 1;
-                        for (int i = n2; i >= 0; i--) {
-                            individual.routes[r1][counter1] = individual.routes[r2][i];
-                            counter1++;
-                        }
-                        int counter2 = 0;
-                        for (int i = individual.node_num[r1] - 1; i >= n1 + 1; i--) {
-                            tempr2[counter2] = tempr[i];
-                            counter2++;
-                        }
-                        for (int i = n2 + 1; i < individual.node_num[r2]; i++) {
-                            tempr2[counter2] = individual.routes[r2][i];
-                            counter2++;
-                        }
-                        memcpy(individual.routes[r2], tempr2, sizeof(int) * individual.node_cap);
-                        individual.node_num[r1] = counter1;
-                        individual.node_num[r2] = counter2;
-
-                        int newdemsum1 = frdem + srdem;
-                        int newdemsum2 = individual.demand_sum[r1] + individual.demand_sum[r2] - frdem - srdem;
-                        individual.demand_sum[r1] = newdemsum1;
-                        individual.demand_sum[r2] = newdemsum2;
-                        updated = true;
-                        updated2 = true;
-                        for (int i = 0; i < r1; i++) {
-                            routepairs.insert({i, r1});
-                        }
-                        for (int i = 0; i < r2; i++) {
-                            routepairs.insert({i, r2});
-                        }
-                        if (individual.demand_sum[r1] == 0) {
-                            int* tempp = individual.routes[r1];
-                            individual.routes[r1] = individual.routes[individual.route_num - 1];
-                            individual.routes[individual.route_num - 1] = tempp;
-                            individual.demand_sum[r1] = individual.demand_sum[individual.route_num - 1];
-                            individual.node_num[r1] = individual.node_num[individual.route_num - 1];
-                            individual.route_num--;
-                            for (int i = 0; i < individual.route_num; i++) {
-                                routepairs.erase({i, individual.route_num});
-                            }
-                        }
-                        if (individual.demand_sum[r2] == 0) {
-                            int* tempp = individual.routes[r2];
-                            individual.routes[r2] = individual.routes[individual.route_num - 1];
-                            individual.routes[individual.route_num - 1] = tempp;
-                            individual.demand_sum[r2] = individual.demand_sum[individual.route_num - 1];
-                            individual.node_num[r2] = individual.node_num[individual.route_num - 1];
-                            individual.route_num--;
-                            for (int i = 0; i < individual.route_num; i++) {
-                                routepairs.erase({i, individual.route_num});
-                            }
-                        }
-                        break;
+                    for (int c = 0; c < count && !updated2; c++) {
+                        // side 0 creates (routes[r1][n1], routes[r2][q]): tails with n2 = q - 1, otherwise n2 = q;
+                        // side 1 creates (routes[r1][n1 + 1], routes[r2][q]): tails with n2 = q, otherwise n2 = q - 1
+                        const int tailsCut = positions[c] - 1 + side;
+                        const int reversedCut = positions[c] - side;
+                        updated2 = (tailsCut >= 0 && index.try_once(2 * tailsCut) && try_move(n1, tailsCut, true)) ||
+                                   (reversedCut >= 0 && index.try_once(2 * reversedCut + 1) && try_move(n1, reversedCut, false));
                     }
+                    if (updated2) break;
                 }
             }
-            if (updated2) break;
         }
+        if (!updated2) continue;
+
+        updated = true;
+        individual.mark_route_changed(r1);
+        individual.mark_route_changed(r2);
+        index_route(r1);
+        index_route(r2);
+        link_route(r1);
+        link_route(r2);
+        sum_route(r1);
+        sum_route(r2);
+        // customers only moved between r1 and r2, so a third route near one of them before may now be near the other
+        for (int i = 0; i < individual.route_num; i++) {
+            char* row = near + static_cast<size_t>(i) * cap;
+            row[r1] = row[r2] = static_cast<char>(row[r1] | row[r2]);
+        }
+        for (int i = 0; i < r1; i++) {
+            push_pair(i, r1);
+        }
+        for (int i = 0; i < r2; i++) {
+            push_pair(i, r2);
+        }
+        if (individual.demand_sum[r1] == 0) {
+            int* tempp = individual.routes[r1];
+            individual.routes[r1] = individual.routes[individual.route_num - 1];
+            individual.routes[individual.route_num - 1] = tempp;
+            individual.demand_sum[r1] = individual.demand_sum[individual.route_num - 1];
+            individual.node_num[r1] = individual.node_num[individual.route_num - 1];
+            individual.route_flags[r1] = individual.route_flags[individual.route_num - 1];
+            individual.route_num--;
+            const int last = individual.route_num;
+            memcpy(near + static_cast<size_t>(r1) * cap, near + static_cast<size_t>(last) * cap, cap);
+            memcpy(prefix + static_cast<size_t>(r1) * stride, prefix + static_cast<size_t>(last) * stride, sizeof(int) * individual.node_num[r1]);
+            for (int i = 0; i < last; i++) {
+                near[static_cast<size_t>(i) * cap + r1] = near[static_cast<size_t>(i) * cap + last];
+            }
+        }
+        if (individual.demand_sum[r2] == 0) {
+            int* tempp = individual.routes[r2];
+            individual.routes[r2] = individual.routes[individual.route_num - 1];
+            individual.routes[individual.route_num - 1] = tempp;
+            individual.demand_sum[r2] = individual.demand_sum[individual.route_num - 1];
+            individual.node_num[r2] = individual.node_num[individual.route_num - 1];
+            individual.route_flags[r2] = individual.route_flags[individual.route_num - 1];
+            individual.route_num--;
+            const int last = individual.route_num;
+            memcpy(near + static_cast<size_t>(r2) * cap, near + static_cast<size_t>(last) * cap, cap);
+            memcpy(prefix + static_cast<size_t>(r2) * stride, prefix + static_cast<size_t>(last) * stride, sizeof(int) * individual.node_num[r2]);
+            for (int i = 0; i < last; i++) {
+                near[static_cast<size_t>(i) * cap + r2] = near[static_cast<size_t>(i) * cap + last];
+            }
+        }
+        if (r1 < individual.route_num) index_route(r1);
+        if (r2 < individual.route_num) index_route(r2);
+    }
+    routepairs.clear();
+    for (int r = 0; r < individual.route_num; r++) {
+        individual.set_route_done(r, Individual::TWO_OPT_STAR_DONE);
     }
-    delete[] tempr;
-    delete[] tempr2;
     return updated;
 }
 
-void node_shift_for_individual(Individual& individual, Case& instance) {
+void node_shift_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator) {
     for (int i = 0; i < individual.route_num; i++) {
-        node_shift(individual.routes[i], individual.node_num[i], individual.fit, instance);
+        if (individual.is_route_done(i, Individual::NODE_SHIFT_DONE)) continue;
+        if (node_shift(individual.routes[i], individual.node_num[i], individual.fit, instance, evaluator)) {
+            individual.mark_route_changed(i);
+        }
+        individual.set_route_done(i, Individual::NODE_SHIFT_DONE);
     }
 }
 
-bool node_shift(int* route, int length, double& fitv, Case& instance) {
+// Granular version: node route[i] is only re-inserted right before or right after one of its neighbours.
+bool node_shift(int* route, int length, double& fitv, const Case& instance, Evaluator& evaluator) {
     if (length <= 4) return false;
+
+    NodeIndex& index = node_index(instance);
+    vector<int>& position = index.position;
+    for (int p = 1; p < length - 1; p++) {
+        position[route[p]] = p;
+    }
+
     double minchange = 0;
     bool flag = false;
     do
@@ -443,35 +805,56 @@ bool node_shift(int* route, int length, double& fitv, Case& instance) {
         minchange = 0;
         int mini = 0, minj = 0;
         for (int i = 1; i < length - 1; i++) {
-            for (int j = 1; j < length - 1; j++) {
-                if (i < j) {
-                    double xx1 = instance.get_distance(route[i - 1], route[i]) + instance.get_distance(route[i], route[i + 1]) + instance.get_distance(route[j], route[j + 1]);
-                    double xx2 = instance.get_distance(route[i - 1], route[i + 1]) + instance.get_distance(route[j], route[i]) + instance.get_distance(route[i], route[j + 1]);
-                    double change = xx1 - xx2;
-                    if (fabs(change) < 0.00000001) change = 0;
-                    if (minchange < change) {
-                        minchange = change;
-                        mini = i;
-                        minj = j;
-                        flag = true;
-                    }
+            index.new_stamp();
+            for (int neighbor : instance.get_neighbors(route[i])) {
+                // moveItoJ(route, i, j) targets: after the neighbour at p is j = p (p > i) or p + 1 (p < i),
+                // before it j = p - 1 (p > i) or p (p < i); the depot only has its "after" start and its "before" end
+                int targets[2];
+                int count = 0;
+                if (neighbor == instance.depot) {
+                    targets[count++] = 1;
+                    targets[count++] = length - 2;
+                } else {
+                    int p = position[neighbor];
+                    if (p <= 0 || p >= length - 1 || route[p] != neighbor) continue;
+                    targets[count++] = p > i ? p : p + 1;
+                    targets[count++] = p > i ? p - 1 : p;
                 }
-                else if (i > j) {
-                    double xx1 = instance.get_distance(route[i - 1], route[i]) + instance.get_distance(route[i], route[i + 1]) + instance.get_distance(route[j - 1], route[j]);
-                    double xx2 = instance.get_distance(route[j - 1], route[i]) + instance.get_distance(route[i], route[j]) + instance.get_distance(route[i - 1], route[i + 1]);
-                    double change = xx1 - xx2;
-                    if (fabs(change) < 0.00000001) change = 0;
-                    if (minchange < change) {
-                        minchange = change;
-                        mini = i;
-                        minj = j;
-                        flag = true;
+                for (int c = 0; c < count; c++) {
+                    int j = targets[c];
+                    if (!index.try_once(j)) continue;
+                    if (i < j) {
+                        double xx1 = evaluator.get_distance(route[i - 1], route[i]) + evaluator.get_distance(route[i], route[i + 1]) + evaluator.get_distance(route[j], route[j + 1]);
+                        double xx2 = evaluator.get_distance(route[i - 1], route[i + 1]) + evaluator.get_distance(route[j], route[i]) + evaluator.get_distance(route[i], route[j + 1]);
+                        double change = xx1 - xx2;
+                        if (fabs(change) < 0.00000001) change = 0;
+                        if (minchange < change) {
+                            minchange = change;
+                            mini = i;
+                            minj = j;
+                            flag = true;
+                        }
+                    }
+                    else if (i > j) {
+                        double xx1 = evaluator.get_distance(route[i - 1], route[i]) + evaluator.get_distance(route[i], route[i + 1]) + evaluator.get_distance(route[j - 1], route[j]);
+                        double xx2 = evaluator.get_distance(route[j - 1], route[i]) + evaluator.get_distance(route[i], route[j]) + evaluator.get_distance(route[i - 1], route[i + 1]);
+                        double change = xx1 - xx2;
+                        if (fabs(change) < 0.00000001) change = 0;
+                        if (minchange < change) {
+                            minchange = change;
+                            mini = i;
+                            minj = j;
+                            flag = true;
+                        }
                     }
                 }
             }
         }
         if (minchange > 0) {
             moveItoJ(route, mini, minj);
+            for (int p = min(mini, minj); p <= max(mini, minj); p++) {
+                position[route[p]] = p;
+            }
             fitv -= minchange;
         }
     } while (minchange > 0);
@@ -495,263 +878,781 @@ void moveItoJ(int* route, int a, int b) {
 }
 
 
-/****************************************************************/
-/*                   Recharging Optimization                    */
-/****************************************************************/
+// Or, I. (1976). Traveling salesman-type combinatorial problems and their relation to the logistics of regional blood banking.
+// Granular Or-opt / relocate: a segment of 1 to MAX_SEGMENT consecutive customers is moved, as is or reversed, next to a
+// neighbour of its first or last node, in its own route or in another route with enough spare capacity. The removal gain
+// of every segment is kept per starting node and refreshed only for the routes a move rewrites, so a candidate costs
+// 3 lookups, charged to the evaluator in bulk. Each customer in turn starts a segment: FIRST_IMPROVEMENT applies its first
+// improving move, BEST_IMPROVEMENT the best one over all its segments; passes repeat until none improves.
+bool or_opt_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator, ImprovementStrategy strategy) {
+    constexpr int MAX_SEGMENT = 3;
+    const int n = instance.actualProblemSize;
+    const DistanceMatrix& d = instance.distances;
+    NodeIndex& index = node_index(instance);
+    if (index.removalGain.size() < static_cast<size_t>(MAX_SEGMENT) * n) {
+        index.removalGain.resize(static_cast<size_t>(MAX_SEGMENT) * n);
+    }
+    double* gain = index.removalGain.data(); // gain[(length - 1) * n + u]: saving of removing the segment of "length" nodes starting at u
+    long long lookups = 0;
 
-double fix_one_solution(Individual &individual, Case& instance) {
-    double updated_fit = 0;
-    vector<vector<int>> repaired_routes;
-    bool isFeasible = true;
-    for (int i = 0; i < individual.route_num; i++) {
-        pair<double, vector<int>> res_xx = insert_station_by_simple_enumeration_array(individual.routes[i], individual.node_num[i], instance);
-        double xx = res_xx.first;
+    auto index_route = [&](int r) {
+        for (int p = 1; p < individual.node_num[r] - 1; p++) {
+            index.route[individual.routes[r][p]] = r;
+            index.position[individual.routes[r][p]] = p;
+        }
+    };
+    auto refresh_route = [&](int r) {
+        index_route(r);
+        const int* route = individual.routes[r];
+        const int last = individual.node_num[r] - 1;
+        for (int p = 1; p < last; p++) {
+            for (int length = 1; length <= MAX_SEGMENT && p + length - 1 < last; length++) {
+                gain[(length - 1) * n + route[p]] = d(route[p - 1], route[p]) + d(route[p + length - 1], route[p + length]) - d(route[p - 1], route[p + length]);
+                lookups += 3;
+            }
+        }
+    };
+    for (int r = 0; r < individual.route_num; r++) {
+        refresh_route(r);
+    }
 
-        if (xx == -1) {
-            pair<double, vector<int>> res_yy = insert_station_by_remove_array(individual.routes[i], individual.node_num[i], instance);
-            double yy = res_yy.first;
-            if (yy == -1) {
-                updated_fit += INFEASIBLE;
-                isFeasible = false;
+    struct Move {
+        double delta;
+        int length, target, after; // the segment goes right after position "after" of route "target"
+        bool reversed;
+    };
+    auto apply = [&](int r, int p, const Move& move, int demand) {
+        int* route = individual.routes[r];
+        int segment[MAX_SEGMENT];
+        for (int k = 0; k < move.length; k++) {
+            segment[k] = route[move.reversed ? p + move.length - 1 - k : p + k];
+        }
+        memmove(route + p, route + p + move.length, sizeof(int) * (individual.node_num[r] - p - move.length));
+        individual.node_num[r] -= move.length;
+
+        const int t = move.target;
+        const int after = t == r && move.after > p ? move.after - move.length : move.after;
+        int* target = individual.routes[t];
+        memmove(target + after + 1 + move.length, target + after + 1, sizeof(int) * (individual.node_num[t] - after - 1));
+        memcpy(target + after + 1, segment, sizeof(int) * move.length);
+        individual.node_num[t] += move.length;
+
+        individual.demand_sum[r] -= demand;
+        individual.demand_sum[t] += demand;
+        individual.fit += move.delta;
+        individual.mark_route_changed(r);
+        individual.mark_route_changed(t);
+        refresh_route(r);
+        if (t != r) refresh_route(t);
+
+        if (individual.node_num[r] == 2) { // the route has been emptied, the last route takes its place
+            const int last = individual.route_num - 1;
+            swap(individual.routes[r], individual.routes[last]);
+            individual.node_num[r] = individual.node_num[last];
+            individual.demand_sum[r] = individual.demand_sum[last];
+            individual.route_flags[r] = individual.route_flags[last];
+            individual.route_num--;
+            if (r < individual.route_num) index_route(r);
+        }
+    };
+
+    bool updated = false;
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (int u : instance.customers) {
+            const int r = index.route[u];
+            const int p = index.position[u];
+            const int* route = individual.routes[r];
+            const int routeLast = individual.node_num[r] - 1;
+
+            Move best{-0.00000001, 0, 0, 0, false};
+            int bestDemand = 0;
+            int demand = 0;
+            for (int length = 1; length <= MAX_SEGMENT && p + length - 1 < routeLast; length++) {
+                const int first = u;
+                const int last = route[p + length - 1];
+                demand += instance.get_customer_demand(last);
+                const double removal = gain[(length - 1) * n + u];
+
+                for (int end = 0; end < 2; end++) { // 0: "first" lands next to the neighbour, 1: "last" does
+                    for (int neighbor : instance.get_neighbors(end == 0 ? first : last)) {
+                        int t = r;
+                        int positions[2];
+                        int count = 0;
+                        if (neighbor == instance.depot) {
+                            positions[count++] = 0;
+                            positions[count++] = routeLast;
+                        } else {
+                            t = index.route[neighbor];
+                            positions[count++] = index.position[neighbor];
+                        }
+                        if (individual.is_route_done(r, Individual::RELOCATE_DONE) && individual.is_route_done(t, Individual::RELOCATE_DONE)) continue;
+                        if (t != r && individual.demand_sum[t] + demand > instance.maxC) continue;
+
+                        const int* target = individual.routes[t];
+                        const int targetLast = individual.node_num[t] - 1;
+                        for (int c = 0; c < count; c++) {
+                            // next to the neighbour at q: right after it or right before it, with the orientation that makes them adjacent
+                            const int q = positions[c];
+                            const int placements[2][2] = {{q, end == 1}, {q - 1, end == 0}};
+                            for (const auto& placement : placements) {
+                                const int after = placement[0];
+                                const bool reversed = placement[1];
+                                if (after < 0 || after >= targetLast) continue;
+                                if (t == r && after + 1 >= p && after <= p + length - 1) continue; // an edge of the segment or next to it
+                                const int a = target[after];
+                                const int b = target[after + 1];
+                                const double delta = d(a, reversed ? last : first) + d(reversed ? first : last, b) - d(a, b) - removal;
+                                lookups += 3;
+                                if (delta < best.delta) {
+                                    best = {delta, length, t, after, reversed};
+                                    bestDemand = demand;
+                                }
+                            }
+                        }
+                        if (strategy == ImprovementStrategy::FIRST_IMPROVEMENT && best.length > 0) break;
+                    }
+                    if (strategy == ImprovementStrategy::FIRST_IMPROVEMENT && best.length > 0) break;
+                }
+                if (strategy == ImprovementStrategy::FIRST_IMPROVEMENT && best.length > 0) break;
             }
-            else {
-                updated_fit += yy;
-                repaired_routes.push_back(res_yy.second);
+
+            if (best.length > 0) {
+                apply(r, p, best, bestDemand);
+                improved = updated = true;
             }
         }
-        else {
-            updated_fit += xx;
-            repaired_routes.push_back(res_xx.second);
-        }
     }
-    individual.set_fit(updated_fit);
-    if (isFeasible) {
-        individual.set_tour(repaired_routes);
+    for (int r = 0; r < individual.route_num; r++) {
+        individual.set_route_done(r, Individual::RELOCATE_DONE);
     }
-    return updated_fit;
+    evaluator.charge_partial_evaluations(lookups);
+
+    return updated;
 }
 
-pair<double, vector<int>> insert_station_by_simple_enumeration_array(int *route, int length, Case& instance) {
-    vector<int> full_route;
-    vector<double> accumulateDistance(length, 0);
-    for (int i = 1; i < length; i++) {
-        accumulateDistance[i] = accumulateDistance[i - 1] + instance.get_distance(route[i], route[i - 1]);
-    }
-    if (accumulateDistance.back() <= instance.maxDis) {
-        for (int i = 0; i < length; ++i) {
-            full_route.push_back(route[i]);
+// Taillard, É. et al. (1997). A tabu search heuristic for the vehicle routing problem with soft time windows.
+// Granular cross-exchange between two routes: the segment of 1 to maxSegment customers starting at u is swapped with the
+// segment of 1 to maxSegment customers that follows v, a neighbour of u in another route, so that u lands right after v.
+// Both segments keep their orientation and both routes must stay within maxC. maxSegment = 1 is the classic swap.
+bool cross_exchange_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator, int maxSegment, ImprovementStrategy strategy) {
+    constexpr int MAX_SEGMENT = 3;
+    maxSegment = max(1, min(maxSegment, MAX_SEGMENT));
+    const DistanceMatrix& d = instance.distances;
+    NodeIndex& index = node_index(instance);
+    long long lookups = 0;
+
+    auto index_route = [&](int r) {
+        for (int p = 1; p < individual.node_num[r] - 1; p++) {
+            index.route[individual.routes[r][p]] = r;
+            index.position[individual.routes[r][p]] = p;
         }
-        return make_pair(accumulateDistance.back(), full_route);
+    };
+    for (int r = 0; r < individual.route_num; r++) {
+        index_route(r);
     }
 
-    int ub = (int)(accumulateDistance.back() / instance.maxDis + 1);
-    int lb = (int)(accumulateDistance.back() / instance.maxDis);
-    int* chosenPos = new int[length];
-    int* bestChosenPos = new int[length]; // customized variable
-    double finalfit = DBL_MAX;
-    double bestfit = finalfit; // customized variable
-    for (int i = lb; i <= ub; i++) {
-        tryACertainNArray(0, i, chosenPos, bestChosenPos, finalfit, i, route, length, accumulateDistance, instance);
-
-        if (finalfit < bestfit) {
-            full_route.clear();
-            int idx = 0;
-            for (int j = 0; j < i; ++j) {
-                int from = route[bestChosenPos[j]];
-                int to = route[bestChosenPos[j] + 1];
-                int station = instance.bestStation[from][to];
-
-                full_route.insert(full_route.end(), route + idx, route + bestChosenPos[j] + 1);
-                full_route.push_back(station);
+    struct Move {
+        double delta;
+        int target, neighborPosition, length, targetLength;
+    };
 
-                idx = bestChosenPos[j] + 1;
+    bool updated = false;
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (int u : instance.customers) {
+            const int r = index.route[u];
+            const int i = index.position[u];
+            const int* route = individual.routes[r];
+            const int routeLast = individual.node_num[r] - 1;
+
+            Move best{-0.00000001, -1, 0, 0, 0};
+            for (int v : instance.get_neighbors(u)) {
+                if (v == instance.depot || index.route[v] == r) continue;
+                const int t = index.route[v];
+                const int j = index.position[v];
+                const int* target = individual.routes[t];
+                const int targetLast = individual.node_num[t] - 1;
+
+                int demandA = 0;
+                for (int la = 1; la <= maxSegment && i + la - 1 < routeLast; la++) {
+                    demandA += instance.get_customer_demand(route[i + la - 1]);
+                    const int lastA = route[i + la - 1];
+                    int demandB = 0;
+                    for (int lb = 1; lb <= maxSegment && j + lb < targetLast; lb++) {
+                        demandB += instance.get_customer_demand(target[j + lb]);
+                        if (individual.demand_sum[r] - demandA + demandB > instance.maxC || individual.demand_sum[t] - demandB + demandA > instance.maxC) continue;
+                        const int lastB = target[j + lb];
+                        const double delta = d(v, u) + d(lastA, target[j + lb + 1]) + d(route[i - 1], target[j + 1]) + d(lastB, route[i + la])
+                                             - d(route[i - 1], u) - d(lastA, route[i + la]) - d(v, target[j + 1]) - d(lastB, target[j + lb + 1]);
+                        lookups += 8;
+                        if (delta < best.delta) {
+                            best = {delta, t, j, la, lb};
+                        }
+                    }
+                }
+                if (strategy == ImprovementStrategy::FIRST_IMPROVEMENT && best.target >= 0) break;
+            }
+            if (best.target < 0) continue;
+
+            // route r: route[i .. i+la-1] becomes the segment of t, t: target[j+1 .. j+lb] becomes the segment of r
+            const int t = best.target;
+            const int la = best.length;
+            const int lb = best.targetLength;
+            const int j = best.neighborPosition;
+            int* routeR = individual.routes[r];
+            int* routeT = individual.routes[t];
+            int segmentA[MAX_SEGMENT];
+            int segmentB[MAX_SEGMENT];
+            int demandA = 0;
+            int demandB = 0;
+            for (int k = 0; k < la; k++) {
+                segmentA[k] = routeR[i + k];
+                demandA += instance.get_customer_demand(segmentA[k]);
+            }
+            for (int k = 0; k < lb; k++) {
+                segmentB[k] = routeT[j + 1 + k];
+                demandB += instance.get_customer_demand(segmentB[k]);
             }
-            full_route.insert(full_route.end(), route + idx, route + length);
-            bestfit = finalfit;
+            memmove(routeR + i + lb, routeR + i + la, sizeof(int) * (individual.node_num[r] - i - la));
+            memcpy(routeR + i, segmentB, sizeof(int) * lb);
+            individual.node_num[r] += lb - la;
+            memmove(routeT + j + 1 + la, routeT + j + 1 + lb, sizeof(int) * (individual.node_num[t] - j - 1 - lb));
+            memcpy(routeT + j + 1, segmentA, sizeof(int) * la);
+            individual.node_num[t] += la - lb;
+
+            individual.demand_sum[r] += demandB - demandA;
+            individual.demand_sum[t] += demandA - demandB;
+            individual.fit += best.delta;
+            individual.mark_route_changed(r);
+            individual.mark_route_changed(t);
+            index_route(r);
+            index_route(t);
+            improved = updated = true;
         }
-
-    }
-    delete[] chosenPos;
-    delete[] bestChosenPos;
-    if (finalfit != DBL_MAX) {
-        return make_pair(finalfit, full_route);
     }
-    else {
-        return make_pair(-1, full_route);
-    }
-}
+    evaluator.charge_partial_evaluations(lookups);
 
-pair<double, vector<int>> insert_station_by_remove_array(int *route, int length, Case& instance) {
-    vector<int> full_route;
+    return updated;
+}
 
-    list<pair<int, int>> stationInserted;
-    for (int i = 0; i < length - 1; i++) {
-        double allowedDis = instance.maxDis;
-        if (i != 0) {
-            allowedDis = instance.maxDis - instance.get_distance(stationInserted.back().second, route[i]);
+// Vidal, T. (2022). Hybrid genetic search for the CVRP: Open-source implementation and SWAP* neighborhood.
+// For two routes r and t, SWAP* exchanges a customer u of r with a customer v of t, each one being re-inserted at its
+// best position in the other route rather than in place of the other. The three cheapest insertions of every customer
+// into the other route are computed once per route pair, which makes the (u, v) evaluation O(1).
+// Only route pairs that share a granular edge are tried, and every pair applies its best improving exchange.
+bool swap_star_for_individual(Individual& individual, const Case& instance, Evaluator& evaluator) {
+    if (individual.route_num < 2) return false;
+
+    const DistanceMatrix& d = instance.distances;
+    NodeIndex& index = node_index(instance);
+    long long lookups = 0;
+
+    auto index_route = [&](int r) {
+        for (int p = 1; p < individual.node_num[r] - 1; p++) {
+            index.route[individual.routes[r][p]] = r;
+            index.position[individual.routes[r][p]] = p;
         }
-        int onestation = instance.find_best_station_feasible(route[i], route[i + 1], allowedDis);
-        if (onestation == -1) return make_pair(-1, full_route);
-        stationInserted.push_back(make_pair(i, onestation));
+    };
+
+    const int cap = individual.route_cap;
+    const size_t cells = static_cast<size_t>(cap) * cap;
+    if (index.routesNear.size() < cells) {
+        index.pairQueued.resize(cells, 0);
+        index.routesNear.resize(cells);
     }
-    while (!stationInserted.empty())
-    {
-        bool change = false;
-        auto delone = stationInserted.begin();
-        double savedis = 0;
-        auto itr = stationInserted.begin();
-        auto next = itr;
-        next++;
-        if (next != stationInserted.end()) {
-            int endInd = next->first;
-            int endstation = next->second;
-            double sumdis = 0;
-            for (int i = 0; i < endInd; i++) {
-                sumdis += instance.get_distance(route[i], route[i + 1]);
-            }
-            sumdis += instance.get_distance(route[endInd], endstation);
-            if (sumdis <= instance.maxDis) {
-                savedis = instance.get_distance(route[itr->first], itr->second)
-                        + instance.get_distance(itr->second, route[itr->first + 1])
-                        - instance.get_distance(route[itr->first], route[itr->first + 1]);
+    char* near = index.routesNear.data();
+
+    struct Insertion {
+        double cost;
+        int after; // inserted between positions after and after + 1
+    };
+    struct TopInsertions {
+        Insertion best[3];
+        void add(double cost, int after) {
+            if (cost >= best[2].cost) return;
+            int k = 2;
+            while (k > 0 && cost < best[k - 1].cost) {
+                best[k] = best[k - 1];
+                k--;
             }
+            best[k] = {cost, after};
         }
-        else {
-            double sumdis = 0;
-            for (int i = 0; i < length - 1; i++) {
-                sumdis += instance.get_distance(route[i], route[i + 1]);
+    };
+    vector<TopInsertions> intoT(individual.node_cap); // per position of r
+    vector<TopInsertions> intoR(individual.node_cap); // per position of t
+    vector<double> removalR(individual.node_cap);
+    vector<double> removalT(individual.node_cap);
+
+    // the top 3 insertions of each customer of "from" into "to", and the removal gain of each customer of "from"
+    auto precompute = [&](const int* from, int fromLen, const int* to, int toLen, vector<TopInsertions>& tops, vector<double>& removal) {
+        for (int p = 1; p < fromLen - 1; p++) {
+            const int x = from[p];
+            removal[p] = d(from[p - 1], x) + d(x, from[p + 1]) - d(from[p - 1], from[p + 1]);
+            TopInsertions& top = tops[p];
+            for (auto& insertion : top.best) insertion = {DBL_MAX, -1};
+            for (int q = 0; q < toLen - 1; q++) {
+                top.add(d(to[q], x) + d(x, to[q + 1]) - d(to[q], to[q + 1]), q);
             }
-            if (sumdis <= instance.maxDis) {
-                savedis = instance.get_distance(route[itr->first], itr->second)
-                        + instance.get_distance(itr->second, route[itr->first + 1])
-                        - instance.get_distance(route[itr->first], route[itr->first + 1]);
+            lookups += 3 + 3 * (toLen - 1);
+        }
+    };
+    // cheapest insertion of x into "to" once the customer at position "removed" has left it, as an "after" in the current positions
+    auto insertion_without = [&](const TopInsertions& top, int x, const int* to, int removed, int& after) {
+        after = removed - 1; // right in the place of the removed customer
+        double cost = d(to[removed - 1], x) + d(x, to[removed + 1]) - d(to[removed - 1], to[removed + 1]);
+        lookups += 3;
+        for (const auto& insertion : top.best) {
+            if (insertion.after < 0 || insertion.after == removed - 1 || insertion.after == removed) continue;
+            if (insertion.cost < cost) {
+                cost = insertion.cost;
+                after = insertion.after;
             }
+            break; // sorted, the first edge not touching the removed customer is the best one
         }
-        itr++;
-        while (itr != stationInserted.end())
-        {
-            int startInd, endInd;
-            next = itr;
-            next++;
-            auto prev = itr;
-            prev--;
-            double sumdis = 0;
-            if (next != stationInserted.end()) {
-                startInd = prev->first + 1;
-                endInd = next->first;
-                sumdis += instance.get_distance(prev->second, route[startInd]);
-                for (int i = startInd; i < endInd; i++) {
-                    sumdis += instance.get_distance(route[i], route[i + 1]);
-                }
-                sumdis += instance.get_distance(route[endInd], next->second);
-                if (sumdis <= instance.maxDis) {
-                    double savedistemp = instance.get_distance(route[itr->first], itr->second)
-                            + instance.get_distance(itr->second, route[itr->first + 1])
-                            - instance.get_distance(route[itr->first], route[itr->first + 1]);
-                    if (savedistemp > savedis) {
-                        savedis = savedistemp;
-                        delone = itr;
-                    }
+        return cost;
+    };
+    // removes the customer at "removed", then inserts x after position "after" (counted before the removal)
+    auto replace = [&](int* route, int length, int removed, int x, int after) {
+        memmove(route + removed, route + removed + 1, sizeof(int) * (length - removed - 1));
+        if (after > removed) after--;
+        memmove(route + after + 2, route + after + 1, sizeof(int) * (length - 1 - after - 1));
+        route[after + 1] = x;
+    };
+
+    bool updated = false;
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (int r = 0; r < individual.route_num; r++) {
+            index_route(r);
+        }
+        for (int r = 0; r < individual.route_num; r++) {
+            char* row = near + static_cast<size_t>(r) * cap;
+            memset(row, 0, cap);
+            for (int p = 1; p < individual.node_num[r] - 1; p++) {
+                for (int neighbor : instance.get_neighbors(individual.routes[r][p])) {
+                    if (neighbor != instance.depot) row[index.route[neighbor]] = 1;
                 }
             }
-            else {
-                startInd = prev->first + 1;
-                sumdis += instance.get_distance(prev->second, route[startInd]);
-                for (int i = startInd; i < length - 1; i++) {
-                    sumdis += instance.get_distance(route[i], route[i + 1]);
-                }
-                if (sumdis <= instance.maxDis) {
-                    double savedistemp = instance.get_distance(route[itr->first], itr->second)
-                            + instance.get_distance(itr->second, route[itr->first + 1])
-                            - instance.get_distance(route[itr->first], route[itr->first + 1]);
-                    if (savedistemp > savedis) {
-                        savedis = savedistemp;
-                        delone = itr;
+        }
+
+        for (int r = 0; r < individual.route_num - 1; r++) {
+            for (int t = r + 1; t < individual.route_num; t++) {
+                if (!near[static_cast<size_t>(r) * cap + t] && !near[static_cast<size_t>(t) * cap + r]) continue;
+                int* routeR = individual.routes[r];
+                int* routeT = individual.routes[t];
+                const int lenR = individual.node_num[r];
+                const int lenT = individual.node_num[t];
+                precompute(routeR, lenR, routeT, lenT, intoT, removalR);
+                precompute(routeT, lenT, routeR, lenR, intoR, removalT);
+
+                double bestDelta = -0.00000001;
+                int bestI = 0, bestJ = 0, bestAfterU = 0, bestAfterV = 0;
+                for (int i = 1; i < lenR - 1; i++) {
+                    const int u = routeR[i];
+                    const int demandU = instance.get_customer_demand(u);
+                    for (int j = 1; j < lenT - 1; j++) {
+                        const int v = routeT[j];
+                        const int demandV = instance.get_customer_demand(v);
+                        if (individual.demand_sum[r] - demandU + demandV > instance.maxC || individual.demand_sum[t] - demandV + demandU > instance.maxC) continue;
+                        // a lower bound first: each insertion costs at least its cheapest one with the other customer still in place
+                        if (intoT[i].best[0].cost + intoR[j].best[0].cost - removalR[i] - removalT[j] >= bestDelta) {
+                            // the in-place insertion may still be cheaper than best[0], so only skip when it cannot be either
+                            double inPlaceU = d(routeT[j - 1], u) + d(u, routeT[j + 1]) - d(routeT[j - 1], routeT[j + 1]);
+                            double inPlaceV = d(routeR[i - 1], v) + d(v, routeR[i + 1]) - d(routeR[i - 1], routeR[i + 1]);
+                            lookups += 6;
+                            if (min(inPlaceU, intoT[i].best[0].cost) + min(inPlaceV, intoR[j].best[0].cost) - removalR[i] - removalT[j] >= bestDelta) continue;
+                        }
+                        int afterU, afterV;
+                        double delta = insertion_without(intoT[i], u, routeT, j, afterU) + insertion_without(intoR[j], v, routeR, i, afterV)
+                                       - removalR[i] - removalT[j];
+                        if (delta < bestDelta) {
+                            bestDelta = delta;
+                            bestI = i;
+                            bestJ = j;
+                            bestAfterU = afterU;
+                            bestAfterV = afterV;
+                        }
                     }
                 }
+                if (bestI == 0) continue;
+
+                const int u = routeR[bestI];
+                const int v = routeT[bestJ];
+                replace(routeR, lenR, bestI, v, bestAfterV);
+                replace(routeT, lenT, bestJ, u, bestAfterU);
+                const int demandShift = instance.get_customer_demand(v) - instance.get_customer_demand(u);
+                individual.demand_sum[r] += demandShift;
+                individual.demand_sum[t] -= demandShift;
+                individual.fit += bestDelta;
+                individual.mark_route_changed(r);
+                individual.mark_route_changed(t);
+                index_route(r);
+                index_route(t);
+                improved = updated = true;
             }
-            itr++;
         }
-        if (savedis != 0) {
-            stationInserted.erase(delone);
-            change = true;
+    }
+    evaluator.charge_partial_evaluations(lookups);
+
+    return updated;
+}
+
+bool apply_neighborhood(Neighborhood neighborhood, Individual& individual, const Case& instance, Evaluator& evaluator, ImprovementStrategy strategy) {
+    switch (neighborhood) {
+        case Neighborhood::TWO_OPT:
+            return two_opt_for_individual(individual, instance, evaluator);
+        case Neighborhood::TWO_OPT_STAR:
+            return two_opt_star_for_individual(individual, instance, evaluator);
+        case Neighborhood::NODE_SHIFT: {
+            double oldFit = individual.fit;
+            node_shift_for_individual(individual, instance, evaluator);
+            return individual.fit != oldFit;
         }
-        if (!change) {
-            break;
+        case Neighborhood::RELOCATE:
+            return or_opt_for_individual(individual, instance, evaluator, strategy);
+        case Neighborhood::SWAP:
+            return cross_exchange_for_individual(individual, instance, evaluator, 1, strategy);
+        case Neighborhood::SWAP_STAR:
+            return swap_star_for_individual(individual, instance, evaluator);
+        case Neighborhood::CROSS_EXCHANGE:
+            return cross_exchange_for_individual(individual, instance, evaluator, 3, strategy);
+    }
+    return false;
+}
+
+/****************************************************************/
+/*                   Recharging Optimization                    */
+/****************************************************************/
+
+double fix_one_solution(Individual &individual, const Case& instance, Evaluator& evaluator, RepairCache* cache) {
+    thread_local pair<double, vector<int>> res_xx; // buffers kept by the thread, a repair allocates nothing once they have grown
+    thread_local vector<int> repairedTour; // every repaired route but its returning depot, then the final depot
+    double updated_fit = 0;
+    repairedTour.clear();
+    bool isFeasible = true;
+    for (int i = 0; i < individual.route_num; i++) {
+        double cachedEvals;
+        if (cache != nullptr && cache->find(individual.routes[i], individual.node_num[i], res_xx, cachedEvals)) {
+            evaluator.charge_evaluations(cachedEvals);
+        } else {
+            double evals = evaluator.get_evals();
+            // optimal over every placement the enumeration and the removal heuristic can find, so no fallback is needed
+            res_xx.first = insert_station_by_labeling(individual.routes[i], individual.node_num[i], instance, evaluator, res_xx.second);
+            if (cache != nullptr) cache->insert(individual.routes[i], individual.node_num[i], res_xx.first, res_xx.second, evaluator.get_evals() - evals);
+        }
+        double xx = res_xx.first;
+
+        if (xx == -1) {
+            updated_fit += INFEASIBLE;
+            isFeasible = false;
+        }
+        else {
+            updated_fit += xx;
+            repairedTour.insert(repairedTour.end(), res_xx.second.begin(), res_xx.second.end() - 1);
         }
     }
-    double sum = 0;
-    for (int i = 0; i < length - 1; i++) {
-        sum += instance.get_distance(route[i], route[i + 1]);
-    }
-    int idx = 0;
-    for (auto& e : stationInserted) {
-        int pos = e.first;
-        int stat = e.second;
-        sum -= instance.get_distance(route[pos], route[pos + 1]);
-        sum += instance.get_distance(route[pos], stat);
-        sum += instance.get_distance(stat, route[pos + 1]);
-        full_route.insert(full_route.end(), route + idx, route + pos + 1);
-        full_route.push_back(stat);
-        idx = pos + 1;
-    }
-    full_route.insert(full_route.end(), route + idx, route + length);
-    return make_pair(sum, full_route);
+    individual.set_fit(updated_fit);
+    if (isFeasible) {
+        repairedTour.push_back(instance.depot);
+        individual.set_tour(repairedTour.data(), static_cast<int>(repairedTour.size()));
+    }
+    return updated_fit;
 }
 
-void tryACertainNArray(int mlen, int nlen, int* chosenPos, int* bestChosenPos, double& finalfit, int curub, int* route, int length, vector<double>& accumulateDis, Case& instance) {
-    for (int i = mlen; i <= length - 1 - nlen; i++) {
-        if (curub == nlen) {
-            double onedis = instance.get_distance(route[i], instance.bestStation[route[i]][route[i + 1]]);
-            if (accumulateDis[i] + onedis > instance.maxDis) {
-                break;
+namespace {
+    // A partial recharging plan of route[0 .. i]: its length, and the range used since the last recharge (or the depot)
+    struct ChargeLabel {
+        double cost;
+        double range;
+        int parent; // label of route[i - 1]
+        int station; // inserted between route[i - 1] and route[i], -1 for none
+        int chainStation; // a second station right before "station", -1 for none
+    };
+
+    // a first station of a two-station chain ending at some station, see chain_shortlists
+    struct ChainEntry {
+        double fromDis; // d(from, first)
+        double cost; // d(from, first) + d(first, last)
+        int first; // station slot
+    };
+
+    struct LabelScratch {
+        vector<ChargeLabel> labels; // layer after layer, each one sorted by increasing range and decreasing cost
+        vector<int> layerStart;
+        vector<ChargeLabel> candidates;
+        vector<double> remaining; // remaining[i]: length of route[i .. length - 1], a lower bound on the cost still to pay
+        vector<int> stationBefore;
+        vector<int> chainBefore;
+        vector<ChainEntry> chains;
+        vector<int> chainStart;
+        vector<int> stationOrder;
+    };
+
+    LabelScratch& label_scratch() {
+        thread_local LabelScratch scratch;
+        return scratch;
+    }
+
+    // For every last station s2 of a chain from "from", the first stations s1 by increasing d(from, s1), keeping only
+    // those that make the chain cheaper than every nearer one: a label of range R uses the last entry with R + d(from, s1) <= maxDis.
+    void chain_shortlists(int from, const Case& instance, LabelScratch& scratch) {
+        const int stationNumber = instance.stationNumber;
+        const double* fromStation = instance.stationDistances[from];
+        vector<int>& order = scratch.stationOrder;
+        order.resize(stationNumber);
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&](int a, int b) { return fromStation[a] < fromStation[b] || (fromStation[a] == fromStation[b] && a < b); });
+
+        scratch.chains.clear();
+        scratch.chainStart.assign(1, 0);
+        for (int last = 0; last < stationNumber; last++) {
+            const double* lastStation = instance.stationDistances[instance.stations[last]];
+            double cheapest = DBL_MAX;
+            for (int first : order) {
+                if (first == last || lastStation[first] > instance.maxDis || fromStation[first] > instance.maxDis) continue;
+                double cost = fromStation[first] + lastStation[first];
+                if (cost < cheapest) {
+                    cheapest = cost;
+                    scratch.chains.push_back({fromStation[first], cost, first});
+                }
             }
+            scratch.chainStart.push_back(static_cast<int>(scratch.chains.size()));
         }
-        else {
-            int lastpos = chosenPos[curub - nlen - 1];
-            double onedis = instance.get_distance(route[lastpos + 1], instance.bestStation[route[lastpos]][route[lastpos + 1]]);
-            double twodis = instance.get_distance(route[i], instance.bestStation[route[i]][route[i + 1]]);
-            if (accumulateDis[i] - accumulateDis[lastpos + 1] + onedis + twodis > instance.maxDis) {
-                break;
+    }
+
+    // Appends to the labels the layer of "to", reached from the layer [first, last) of "from" by the edge (from, to),
+    // keeping the labels cheaper than "limit". False when the new layer is empty.
+    bool extend_labels(int from, int to, int first, int last, double limit, int maxStationsPerEdge, const Case& instance, LabelScratch& scratch, long long& lookups) {
+        vector<ChargeLabel>& labels = scratch.labels;
+        vector<ChargeLabel>& candidates = scratch.candidates;
+        const double* fromStation = instance.stationDistances[from];
+        const double* toStation = instance.stationDistances[to];
+        const double edge = instance.distances(from, to);
+        // the cheapest label that still reaches a station "dis" away is the last one within range
+        auto reaching = [&](double dis) {
+            auto reach = partition_point(labels.begin() + first, labels.begin() + last, [&](const ChargeLabel& label) {
+                return label.range + dis <= instance.maxDis;
+            });
+            return static_cast<int>(reach - labels.begin()) - 1;
+        };
+
+        candidates.clear();
+        for (int k = first; k < last && labels[k].range + edge <= instance.maxDis; k++) {
+            if (labels[k].cost + edge < limit) candidates.push_back({labels[k].cost + edge, labels[k].range + edge, k, -1, -1});
+        }
+        for (int s = 0; s < instance.stationNumber; s++) {
+            if (toStation[s] > instance.maxDis) continue;
+            const int k = reaching(fromStation[s]);
+            if (k < first) continue;
+            double cost = labels[k].cost + fromStation[s] + toStation[s];
+            if (cost < limit) candidates.push_back({cost, toStation[s], k, instance.stations[s], -1});
+        }
+        lookups += 2LL * instance.stationNumber;
+
+        if (maxStationsPerEdge >= 2) {
+            chain_shortlists(from, instance, scratch);
+            lookups += 1LL * instance.stationNumber * instance.stationNumber;
+            for (int s = 0; s < instance.stationNumber; s++) {
+                if (toStation[s] > instance.maxDis) continue;
+                auto begin = scratch.chains.begin() + scratch.chainStart[s];
+                auto end = scratch.chains.begin() + scratch.chainStart[s + 1];
+                for (int k = first; k < last; k++) {
+                    auto reach = partition_point(begin, end, [&](const ChainEntry& chain) {
+                        return labels[k].range + chain.fromDis <= instance.maxDis;
+                    });
+                    if (reach == begin) break; // later labels have a larger range
+                    const ChainEntry& chain = *(reach - 1);
+                    double cost = labels[k].cost + chain.cost + toStation[s];
+                    if (cost < limit) candidates.push_back({cost, toStation[s], k, instance.stations[s], instance.stations[chain.first]});
+                }
             }
         }
-        if (nlen == 1) {
-            double onedis = accumulateDis.back() - accumulateDis[i + 1] + instance.get_distance(instance.bestStation[route[i]][route[i + 1]], route[i + 1]);
-            if (onedis > instance.maxDis) {
-                continue;
+
+        sort(candidates.begin(), candidates.end(), [](const ChargeLabel& a, const ChargeLabel& b) {
+            return a.range < b.range || (a.range == b.range && a.cost < b.cost);
+        });
+        double cheapest = DBL_MAX;
+        for (const auto& candidate : candidates) {
+            if (candidate.cost < cheapest) {
+                cheapest = candidate.cost;
+                labels.push_back(candidate);
             }
         }
+        return static_cast<int>(labels.size()) > last;
+    }
+}
+
+// The lookups insert_station_by_labeling charges for a route that has a plan with at most one station per edge
+long long labeling_lookups(const int* route, int length, const Case& instance) {
+    double distance = 0;
+    for (int i = length - 2; i >= 0; i--) distance += instance.distances(route[i], route[i + 1]);
+    return distance <= instance.maxDis ? length - 1 : (length - 1) * (1 + 2LL * instance.stationNumber);
+}
+
+// Labelling over the route positions: at every edge, either no station or any station is inserted, and a label is
+// kept only if no other label of the same position has both a lower cost and a lower range. The range of a label is
+// the distance since its last station, so a position holds at most one label per (station, edge) before it plus one,
+// which bounds the work by O(L^2 S) and in practice by O(L S). The result is optimal among the plans with at most one
+// station per edge.
+// With maxStationsPerEdge = 2 an edge may also get a chain of two stations, for O(L S^2 log S) more work.
+// Labels that cannot end below "bound" are dropped, and -1 is returned when no plan beats it.
+pair<double, vector<int>> insert_station_by_labeling(int* route, int length, const Case& instance, Evaluator& evaluator, int maxStationsPerEdge, double bound) {
+    vector<int> full_route;
+    double cost = insert_station_by_labeling(route, length, instance, evaluator, full_route, maxStationsPerEdge, bound);
+    return make_pair(cost, full_route);
+}
+
+double insert_station_by_labeling(int* route, int length, const Case& instance, Evaluator& evaluator, vector<int>& full_route, int maxStationsPerEdge, double bound) {
+    full_route.clear();
+    LabelScratch& scratch = label_scratch();
+    vector<double>& remaining = scratch.remaining;
+    remaining.assign(length, 0.0);
+    for (int i = length - 2; i >= 0; i--) {
+        remaining[i] = remaining[i + 1] + instance.distances(route[i], route[i + 1]);
+    }
+    long long lookups = length - 1;
+    if (remaining[0] <= instance.maxDis) {
+        evaluator.charge_partial_evaluations(lookups);
+        if (remaining[0] >= bound) return -1;
+        full_route.assign(route, route + length);
+        return remaining[0];
+    }
+
+    vector<ChargeLabel>& labels = scratch.labels;
+    vector<int>& layerStart = scratch.layerStart;
+    labels.assign(1, {0.0, 0.0, -1, -1, -1});
+    layerStart.assign(1, 0);
+    layerStart.push_back(1);
 
-        chosenPos[curub - nlen] = i;
-        if (nlen > 1) {
-            tryACertainNArray(i + 1, nlen - 1, chosenPos,  bestChosenPos, finalfit, curub, route, length, accumulateDis, instance);
+    for (int i = 0; i < length - 1; i++) {
+        // a label of route[i + 1] must cost less than bound - remaining[i + 1]
+        if (!extend_labels(route[i], route[i + 1], layerStart[i], layerStart[i + 1], bound - remaining[i + 1], maxStationsPerEdge, instance, scratch, lookups)) {
+            evaluator.charge_partial_evaluations(lookups);
+            return -1;
         }
-        else {
-            double disum = accumulateDis.back();
-            for (int j = 0; j < curub; j++) {
-                int firstnode = route[chosenPos[j]];
-                int secondnode = route[chosenPos[j] + 1];
-                int thestation = instance.bestStation[firstnode][secondnode];
-                disum -= instance.get_distance(firstnode, secondnode);
-                disum += instance.get_distance(firstnode, thestation);
-                disum += instance.get_distance(secondnode, thestation);
-            }
-            if (disum < finalfit) {
-                finalfit = disum;
-                for (int j = 0; j < length; ++j) {
-                    bestChosenPos[j] = chosenPos[j];
+        layerStart.push_back(static_cast<int>(labels.size()));
+    }
+    evaluator.charge_partial_evaluations(lookups);
+
+    // the last label of the final layer is the cheapest one, its parents give the stations before every position
+    vector<int>& stationBefore = scratch.stationBefore;
+    vector<int>& chainBefore = scratch.chainBefore;
+    stationBefore.assign(length, -1);
+    chainBefore.assign(length, -1);
+    int k = static_cast<int>(labels.size()) - 1;
+    const double cost = labels[k].cost;
+    int stationNum = 0;
+    for (int i = length - 1; i > 0; i--, k = labels[k].parent) {
+        stationBefore[i] = labels[k].station;
+        chainBefore[i] = labels[k].chainStation;
+        stationNum += (labels[k].station >= 0) + (labels[k].chainStation >= 0);
+    }
+    full_route.reserve(length + stationNum);
+    full_route.push_back(route[0]);
+    for (int i = 1; i < length; i++) {
+        if (chainBefore[i] >= 0) full_route.push_back(chainBefore[i]);
+        if (stationBefore[i] >= 0) full_route.push_back(stationBefore[i]);
+        full_route.push_back(route[i]);
+    }
+    return cost;
+}
+
+namespace {
+    // Split whose arc cost is the optimal recharged length of the route, from insert_station_by_labeling: the labels of
+    // depot, x[i + 1 .. t] are extended by one layer as the route grows, and closing the route is one more tentative
+    // layer to the depot. A route grows until it exceeds maxC or no plan reaches x[t]. O(n·B·S) lookups, where prins_split
+    // takes O(n·B). Routes without any recharging plan are never chosen, linear_split is used when no split has a plan.
+    // The routes are left in the pred of the split scratch, with their recharging plans.
+    SplitScratch& solve_energy_split(const vector<int>& x, const Case& instance, Evaluator& evaluator, int maxStationsPerEdge) {
+        SplitScratch& split = split_scratch(x, instance, evaluator);
+        LabelScratch& scratch = label_scratch();
+        vector<ChargeLabel>& labels = scratch.labels;
+        vector<int>& layerStart = scratch.layerStart;
+        const int n = static_cast<int>(x.size()) - 1;
+        vector<double>& potential = split.potential;
+        fill(potential.begin() + 1, potential.end(), DBL_MAX);
+        if (static_cast<int>(split.plan.size()) < n + 1) split.plan.resize(n + 1);
+        split.planCost.resize(n + 1);
+        long long lookups = 0;
+
+        for (int i = 0; i < n; i++) {
+            if (potential[i] == DBL_MAX) continue;
+            labels.assign(1, {0.0, 0.0, -1, -1, -1});
+            layerStart.assign(1, 0);
+            layerStart.push_back(1);
+            int from = instance.depot;
+            for (int t = i + 1; t <= n && split.load[t] - split.load[i] <= instance.maxC; t++) {
+                const int layer = static_cast<int>(layerStart.size()) - 2;
+                if (!extend_labels(from, x[t], layerStart[layer], layerStart[layer + 1], DBL_MAX, maxStationsPerEdge, instance, scratch, lookups)) break;
+                layerStart.push_back(static_cast<int>(labels.size()));
+                const int routeEnd = static_cast<int>(labels.size());
+                // the last label of the closing layer is the cheapest one
+                if (extend_labels(x[t], instance.depot, layerStart[layer + 1], routeEnd, potential[t] - potential[i], maxStationsPerEdge, instance, scratch, lookups)) {
+                    potential[t] = potential[i] + labels.back().cost;
+                    split.pred[t] = i;
+                    split.planCost[t] = labels.back().cost;
+                    // the plan, backwards from the closing label: its stations, then the node before them
+                    vector<int>& plan = split.plan[t];
+                    plan.assign(1, instance.depot);
+                    for (int j = t + 1, k = static_cast<int>(labels.size()) - 1; j > i; j--, k = labels[k].parent) {
+                        if (labels[k].station >= 0) plan.push_back(labels[k].station);
+                        if (labels[k].chainStation >= 0) plan.push_back(labels[k].chainStation);
+                        plan.push_back(j - 1 > i ? x[j - 1] : instance.depot);
+                    }
+                    reverse(plan.begin(), plan.end());
                 }
+                labels.resize(routeEnd);
+                from = x[t];
+            }
+        }
+        evaluator.charge_partial_evaluations(lookups);
+
+        if (potential[n] == DBL_MAX) return solve_linear_split(x, instance, evaluator);
+        split.hasPlans = true;
+        return split;
+    }
+}
+
+vector<vector<int>> energy_split(const vector<int>& x, const Case& instance, Evaluator& evaluator, int maxStationsPerEdge) {
+    return split_routes(x, solve_energy_split(x, instance, evaluator, maxStationsPerEdge));
+}
+
+// The routes go straight from the split scratch into the arrays of the individual, in the order of split_giant_tour.
+// The recharging plans of ENERGY go into the cache, charged as the repair they replace, so that fix_one_solution
+// finds them while the routes are unchanged.
+void decode_giant_tour(SplitMethod method, const vector<int>& x, const Case& instance, Evaluator& evaluator, Individual& individual, RepairCache* cache) {
+    individual.reset();
+    if (method == SplitMethod::LINEAR || method == SplitMethod::ENERGY) {
+        const SplitScratch& split = method == SplitMethod::LINEAR ? solve_linear_split(x, instance, evaluator) : solve_energy_split(x, instance, evaluator, 1);
+        for (int t = static_cast<int>(x.size()) - 1; t > 0; t = split.pred[t]) {
+            const int i = split.pred[t];
+            individual.append_route(instance.depot, x.data() + i + 1, t - i, split.load[t] - split.load[i]);
+            if (split.hasPlans && cache != nullptr) {
+                const int r = individual.route_num - 1;
+                const double evals = static_cast<double>(labeling_lookups(individual.routes[r], individual.node_num[r], instance)) / instance.actualProblemSize;
+                cache->insert(individual.routes[r], individual.node_num[r], split.planCost[t], split.plan[t], evals);
             }
         }
+    } else {
+        for (const auto& route : split_giant_tour(method, x, instance, evaluator)) {
+            int demand = 0;
+            for (int customer : route) demand += instance.get_customer_demand(customer);
+            individual.append_route(instance.depot, route.data(), static_cast<int>(route.size()), demand);
+        }
     }
+    individual.set_fit(evaluator.fitness_evaluation(individual.routes, individual.node_num, individual.route_num));
 }
 
-pair<double, vector<int>> simple_repair_target_one_station(const int* route, int length, Case& instance) {
+pair<double, vector<int>> simple_repair_target_one_station(const int* route, int length, const Case& instance, Evaluator& evaluator) {
     vector<int> fullRoute;
 
     vector<double> distances(length, 0);
     for (int i = 1; i < length; i++) {
-        distances[i] = instance.get_distance(route[i], route[i - 1]);
+        distances[i] = evaluator.get_distance(route[i], route[i - 1]);
     }
     double dumbTotalDistance = std::accumulate(distances.begin(), distances.end(), 0.0);
 
@@ -773,7 +1674,7 @@ pair<double, vector<int>> simple_repair_target_one_station(const int* route, int
         if(availableRange >= distances[next]) {
 
             // 判断是否从current可以到达next
-            if (availableRange - distances[next] >= instance.customerNearestStationMap[route[next]].second || next == length - 1 ) {
+            if (availableRange - distances[next] >= instance.customerNearestStationMap.at(route[next]).second || next == length - 1 ) {
                 // 判断是否next可以到达最近的充电站，假设EV到达next 或者 下一个节点为仓库
                 fullRoute.push_back(route[next]);
                 accumulatedTotalDistance += distances[next];
@@ -781,24 +1682,24 @@ pair<double, vector<int>> simple_repair_target_one_station(const int* route, int
             } else {
                 // 若从next出发无法到达充电站，那么我们应该在前一段旅程中充电，即在current后面充电
                 // 我们希望找到一个充电站，从current出发可达，且最靠近next （goal - 用尽可能少的充电站）
-                int station = instance.find_nearest_station_to_y_feasible(route[current], route[next], availableRange);
+                int station = evaluator.find_nearest_station_to_y_feasible(route[current], route[next], availableRange);
                 if (station == -1) throw std::runtime_error("Cannot find feasible station!"); // in theory, it shouldn't happen
                 fullRoute.push_back(station);
                 fullRoute.push_back(route[next]);
-                double current2station = instance.get_distance(route[current], station);
-                double station2next = instance.get_distance(station, route[next]);
+                double current2station = evaluator.get_distance(route[current], station);
+                double station2next = evaluator.get_distance(station, route[next]);
                 accumulatedTotalDistance += current2station + station2next;
                 availableRange = instance.maxDis - station2next;
             }
         } else {
-            int station = instance.find_nearest_station_to_y_feasible(route[current], route[next], availableRange);
+            int station = evaluator.find_nearest_station_to_y_feasible(route[current], route[next], availableRange);
             if (station == -1) throw std::runtime_error("Cannot find feasible station from current!"); // in theory, it shouldn't happen
             fullRoute.push_back(station);
             fullRoute.push_back(route[next]);
-            double current2station = instance.get_distance(route[current], station);
-            double station2next = instance.get_distance(station, route[next]);
+            double current2station = evaluator.get_distance(route[current], station);
+            double station2next = evaluator.get_distance(station, route[next]);
             accumulatedTotalDistance += current2station + station2next;
-            availableRange = instance.maxDis - instance.get_distance(station, route[next]);
+            availableRange = instance.maxDis - evaluator.get_distance(station, route[next]);
         }
         current = next;
         next = current + 1;
@@ -808,7 +1709,7 @@ pair<double, vector<int>> simple_repair_target_one_station(const int* route, int
     return make_pair(accumulatedTotalDistance, fullRoute);
 }
 
-pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRoute, double forwardFit, Case& instance) {
+pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRoute, double forwardFit, const Case& instance, Evaluator& evaluator) {
     // input arguments check
     int stationNum = 0;
     vector<int> dumbForwardRoute;
@@ -827,7 +1728,7 @@ pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRou
 
     int* route = new int[dumbForwardRoute.size()];
     std::copy(dumbForwardRoute.rbegin(), dumbForwardRoute.rend(), route);
-    pair<double, vector<int>> reverseRouteInfo = simple_repair_target_one_station(route,dumbForwardRoute.size(), instance);
+    pair<double, vector<int>> reverseRouteInfo = simple_repair_target_one_station(route,dumbForwardRoute.size(), instance, evaluator);
     delete []route;
     vector<int> repairedBackwardRoute = reverseRouteInfo.second;
     double backwardFit = reverseRouteInfo.first;
@@ -845,13 +1746,13 @@ pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRou
 
     vector<vector<double>> distanceMatrix(instance.customerNumber + 1, vector<double>(instance.customerNumber + 1, 0.0));
     for (int i = 0; i < dumbForwardRoute.size() - 1; ++i) {
-        double distance = instance.get_distance(dumbForwardRoute[i], dumbForwardRoute[i+1]);
+        double distance = evaluator.get_distance(dumbForwardRoute[i], dumbForwardRoute[i+1]);
         distanceMatrix[dumbForwardRoute[i]][dumbForwardRoute[i+1]] = distance;
         distanceMatrix[dumbForwardRoute[i+1]][dumbForwardRoute[i]] = distance;
     }
     double totalDumbDistance = forwardFit
-            - instance.get_distance(repairedForwardRoute[posStationForward - 1], repairedForwardRoute[posStationForward])
-            - instance.get_distance(repairedForwardRoute[posStationForward], repairedForwardRoute[posStationForward + 1])
+            - evaluator.get_distance(repairedForwardRoute[posStationForward - 1], repairedForwardRoute[posStationForward])
+            - evaluator.get_distance(repairedForwardRoute[posStationForward], repairedForwardRoute[posStationForward + 1])
             + distanceMatrix[repairedForwardRoute[posStationForward - 1]][repairedForwardRoute[posStationForward + 1]];
 
     double bestFitForward = forwardFit;
@@ -869,8 +1770,8 @@ pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRou
         // insert station after idx
         int station = instance.bestStation[dumbForwardRoute[idx]][dumbForwardRoute[idx + 1]];
 
-        double from2station = instance.get_distance(dumbForwardRoute[idx], station);
-        double station2to   = instance.get_distance(station, dumbForwardRoute[idx + 1]);
+        double from2station = evaluator.get_distance(dumbForwardRoute[idx], station);
+        double station2to   = evaluator.get_distance(station, dumbForwardRoute[idx + 1]);
 
         // better? if worse, just continue
         double updatedTotalDumbDistance = totalDumbDistance - distanceMatrix[dumbForwardRoute[idx]][dumbForwardRoute[idx + 1]];
@@ -923,8 +1824,8 @@ pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRou
         // insert station after idx
         int station = instance.bestStation[dumbBackwardRoute[idx]][dumbBackwardRoute[idx + 1]];
 
-        double from2station = instance.get_distance(dumbBackwardRoute[idx], station);
-        double station2to   = instance.get_distance(station, dumbBackwardRoute[idx + 1]);
+        double from2station = evaluator.get_distance(dumbBackwardRoute[idx], station);
+        double station2to   = evaluator.get_distance(station, dumbBackwardRoute[idx + 1]);
 
         // better? if worse, just continue
         double updatedTotalDumbDistance = totalDumbDistance - distanceMatrix[dumbBackwardRoute[idx]][dumbBackwardRoute[idx + 1]];
@@ -979,90 +1880,59 @@ pair<double, vector<int>> station_reallocate_one(vector<int>& repairedForwardRou
 /*                            Refine                            */
 /****************************************************************/
 
-pair<vector<int>, double> insert_station_by_enumeration(vector<int>& route, Case& instance) {
-    vector<double> accumulateDistance(route.size(), 0);
-    for (int i = 1; i < (int)route.size(); i++) {
-        accumulateDistance[i] = accumulateDistance[i - 1] + instance.get_distance(route[i], route[i - 1]);
-    }
-    if (accumulateDistance.back() <= instance.maxDis) {
-        return make_pair(route, accumulateDistance.back());
+// The recharging of every route is re-optimized over a larger space than fix_one_solution: an edge may also get a chain of
+// two stations. The bound of a route is its repaired length in the current tour, which fix_one_solution found optimal
+// with single stations, so the chain labels only survive where they can beat it. The refined tour is rebuilt in a
+// buffer of the thread and the individual is updated only when a route improves.
+double refine_individual(Individual& individual, const Case& instance, Evaluator& evaluator) {
+    if (individual.route_num == 0 || individual.get_fit() >= INFEASIBLE || individual.steps == 0) {
+        return individual.get_fit(); // nothing decoded or no repaired tour to refine
     }
-
-    int ub = ceil(accumulateDistance.back() / instance.maxDis);
-    int lb = floor(accumulateDistance.back() / instance.maxDis);
-    int* chosenPos = new int[route.size()];
-    int* chosenSta = new int[route.size()];
-    vector<int> finalRoute;
-    double finalfit = DBL_MAX;
-    for (int i = lb; i <= ub; i++) {
-        tryACertainN(0, i, chosenSta, chosenPos, finalRoute, finalfit, i, route, accumulateDistance, instance);
-    }
-    delete[] chosenPos;
-    delete[] chosenSta;
-    if (finalfit != DBL_MAX) {
-        return make_pair(finalRoute, finalfit);
+    thread_local vector<int> chained;
+    thread_local vector<int> refinedTour; // every route but its returning depot, then the final depot
+    refinedTour.clear();
+    const int* tour = individual.tour.data();
+    const int steps = individual.steps;
+    double gain = 0;
+    long long lookups = 0;
+    int first = 0; // the repaired route i is tour[first .. last], from a depot to the next one
+    for (int i = 0; i < individual.route_num; i++) {
+        int last = first + 1;
+        double repaired = 0;
+        for (; last < steps; last++) {
+            repaired += instance.distances(tour[last - 1], tour[last]);
+            if (tour[last] == instance.depot) break;
+        }
+        if (last >= steps) return individual.get_fit(); // the tour does not hold every route
+        lookups += last - first;
+        double cost = insert_station_by_labeling(individual.routes[i], individual.node_num[i], instance, evaluator, chained, 2, repaired);
+        if (cost != -1) {
+            gain += cost - repaired;
+            refinedTour.insert(refinedTour.end(), chained.begin(), chained.end() - 1);
+        } else {
+            refinedTour.insert(refinedTour.end(), tour + first, tour + last);
+        }
+        first = last;
     }
-    else {
-        return make_pair(route, -1);
+    evaluator.charge_partial_evaluations(lookups);
+    if (gain < 0) {
+        refinedTour.push_back(instance.depot);
+        individual.set_fit(individual.get_fit() + gain);
+        individual.set_tour(refinedTour.data(), static_cast<int>(refinedTour.size()));
     }
+    return individual.get_fit();
 }
 
-void tryACertainN(int mlen, int nlen, int* chosenSta, int* chosenPos, vector<int>& finalRoute, double& finalfit, int curub, vector<int>& route, vector<double>& accumulateDis, Case& instance) {
-    for (int i = mlen; i <= (int)route.size() - 1 - nlen; i++) {
-        if (curub == nlen) {
-            if (accumulateDis[i] >= instance.maxDis) {
-                break;
-            }
-        }
-        else {
-            if (accumulateDis[i] - accumulateDis[chosenPos[curub - nlen - 1] + 1] >= instance.maxDis) {
-                break;
-            }
-        }
-        if (nlen == 1) {
-            if (accumulateDis.back() - accumulateDis[i + 1] >= instance.maxDis) {
-                continue;
-            }
-        }
-        for (int j = 0; j < instance.stationNumber; j++) { //TODO: 这个地方可以琢磨修改 (int)instance->bestStations[route[i]][route[i + 1]].size()
-            chosenSta[curub - nlen] = instance.stations[j];
-            chosenPos[curub - nlen] = i;
-            if (nlen > 1) {
-                tryACertainN(i + 1, nlen - 1, chosenSta, chosenPos, finalRoute, finalfit, curub, route, accumulateDis, instance);
-            }
-            else {
-                bool feasible = true;
-                double piecedis = accumulateDis[chosenPos[0]] + instance.get_distance(route[chosenPos[0]],chosenSta[0]);
-                if (piecedis > instance.maxDis) feasible = false;
-                for (int k = 1; feasible && k < curub; k++) {
-                    piecedis = accumulateDis[chosenPos[k]] - accumulateDis[chosenPos[k - 1] + 1];
-                    piecedis += instance.get_distance(chosenSta[k - 1], route[chosenPos[k - 1] + 1]);
-                    piecedis += instance.get_distance(chosenSta[k], route[chosenPos[k]]);
-                    if (piecedis > instance.maxDis) feasible = false;
-                }
-                piecedis = accumulateDis.back() - accumulateDis[chosenPos[curub - 1] + 1];
-                piecedis += instance.get_distance(route[chosenPos[curub - 1] + 1],chosenSta[curub - 1]);
-                if (piecedis > instance.maxDis) feasible = false;
-                if (feasible) {
-                    double totaldis = accumulateDis.back();
-                    for (int k = 0; k < curub; k++) {
-                        int firstnode = route[chosenPos[k]];
-                        int secondnode = route[chosenPos[k] + 1];
-                        totaldis -= instance.get_distance(firstnode,secondnode);
-                        totaldis += instance.get_distance(firstnode,chosenSta[k]);
-                        totaldis += instance.get_distance(chosenSta[k],secondnode);
-                    }
-                    if (totaldis < finalfit) {
-                        finalfit = totaldis;
-                        finalRoute = route;
-                        for (int k = curub - 1; k >= 0; k--) {
-                            finalRoute.insert(finalRoute.begin() + chosenPos[k] + 1, chosenSta[k]);
-                        }
-                    }
-                }
-            }
-        }
-    }
+// The lookups of refine_individual: the repaired tour once, then for every edge of every route the (2 + S) S of a
+// labeling layer with chains plus its own length, see insert_station_by_labeling. An upper bound, a labeling stops
+// early when no plan beats the bound.
+double refine_charge(const Individual& individual, const Case& instance) {
+    if (individual.route_num == 0 || individual.get_fit() >= INFEASIBLE || individual.steps == 0) return 0;
+    const long long stations = instance.stationNumber;
+    long long edges = 0;
+    for (int i = 0; i < individual.route_num; i++) edges += individual.node_num[i] - 1;
+    const long long lookups = individual.steps - 1 + edges * (1 + (2 + stations) * stations);
+    return static_cast<double>(lookups) / instance.actualProblemSize;
 }
 
 
@@ -1114,6 +1984,8 @@ vector<shared_ptr<Individual>> selTournament(const vector<shared_ptr<Individual>
 }
 
 void cxPartiallyMatched(vector<int>& parent1, vector<int>& parent2, std::default_random_engine& rng) {
+    // the children and the gene mappings are kept by the thread, -1 marks an unmapped gene
+    thread_local vector<int> child1, child2, mapping1, mapping2;
     int size = parent1.size();
 
     uniform_int_distribution<> distribution(0, size - 1);
@@ -1126,12 +1998,16 @@ void cxPartiallyMatched(vector<int>& parent1, vector<int>& parent2, std::default
     }
 
     // Copy the middle segment from parents to children
-    vector<int> child1(parent1.begin() + point1, parent1.begin() + point2);
-    vector<int> child2(parent2.begin() + point1, parent2.begin() + point2);
+    child1.assign(parent1.begin() + point1, parent1.begin() + point2);
+    child2.assign(parent2.begin() + point1, parent2.begin() + point2);
 
     // Create a mapping of genes between parents
-    unordered_map<int, int> mapping1;
-    unordered_map<int, int> mapping2;
+    int maxGene = 0;
+    for (int i = 0; i < size; ++i) {
+        maxGene = max(maxGene, max(parent1[i], parent2[i]));
+    }
+    mapping1.assign(maxGene + 1, -1);
+    mapping2.assign(maxGene + 1, -1);
 
     // Initialize mapping with the middle segment
     for (int i = 0; i < point2 - point1; ++i) {
@@ -1145,11 +2021,11 @@ void cxPartiallyMatched(vector<int>& parent1, vector<int>& parent2, std::default
             int gene1 = parent1[i];
             int gene2 = parent2[i];
 
-            while (mapping1.find(gene1) != mapping1.end()) {
+            while (mapping1[gene1] != -1) {
                 gene1 = mapping1[gene1];
             }
 
-            while (mapping2.find(gene2) != mapping2.end()) {
+            while (mapping2[gene2] != -1) {
                 gene2 = mapping2[gene2];
             }
 
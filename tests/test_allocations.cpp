@@ -0,0 +1,80 @@
+// A generation of the MA must not allocate once its buffers have grown: operator new is replaced by a counting one, and
+// a few generations after the confidence intervals are in place (gen > delta) must count no allocation, sequential or
+// with a pool. The repair cache still allocates while it grows, so the generations counted must not add entries to it.
+// The same holds for a second refine_individual of the best individual.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "test_utils.hpp"
+#include "../include/case.hpp"
+#include "../include/MA.hpp"
+
+using namespace std;
+
+static atomic<bool> counting{false};
+static atomic<long long> allocations{0};
+
+void* operator new(size_t size) {
+    if (counting.load(memory_order_relaxed)) allocations.fetch_add(1, memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+static void check_steady_state(const shared_ptr<const Case>& instance, int threadNum) {
+    MA ma(instance, 1, 1);
+    ma.set_thread_num(threadNum);
+    ma.initialize_heuristic();
+    while (ma.gen <= ma.delta + 10) {
+        ma.run_heuristic();
+    }
+
+    const size_t cacheSize = ma.repairCache.size();
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < 5; ++i) {
+        ma.run_heuristic();
+    }
+    counting = false;
+    CHECK(ma.repairCache.size() == cacheSize);
+    if (allocations != 0) cerr << allocations << " allocations with " << threadNum << " thread(s)" << endl;
+    CHECK(allocations == 0);
+
+    // the final refine rebuilds the tour in the buffers of the thread, which have grown after a first refine
+    refine_individual(*ma.globalBest, *instance, ma.evaluator);
+    allocations = 0;
+    counting = true;
+    refine_individual(*ma.globalBest, *instance, ma.evaluator);
+    counting = false;
+    if (allocations != 0) cerr << allocations << " allocations in refine_individual" << endl;
+    CHECK(allocations == 0);
+}
+
+int main() {
+    auto instance = make_shared<const Case>(data_file("E-n22-k4.evrp"), DistanceStorage::FULL_DOUBLE, false);
+    check_steady_state(instance, 1);
+    check_steady_state(instance, 2);
+    return 0;
+}
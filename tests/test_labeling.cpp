@@ -0,0 +1,131 @@
+// insert_station_by_labeling is the only recharging repair, and it claims the optimal plan among those with at most
+// maxStationsPerEdge stations per edge. On short random routes of the E instances it must give the cost of a
+// brute-force enumeration of every such plan, -1 exactly when none exists, and a repaired tour that keeps the customers
+// in order, never runs out of energy and has the returned length.
+
+#include <random>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#include "test_utils.hpp"
+#include "../include/case.hpp"
+#include "../include/evaluator.hpp"
+#include "../include/utils.hpp"
+
+using namespace std;
+
+// Depth-first over the edges of the route: each one is driven directly, through a station or, with
+// maxStationsPerEdge = 2, through a chain of two different stations. "range" is the distance since the last recharge,
+// branches that cannot beat "best" even without any detour are cut, which keeps the search exact.
+static void enumerate(const vector<int>& route, size_t i, double range, double cost, const vector<double>& remaining,
+                      int maxStationsPerEdge, const Case& instance, double& best) {
+    if (cost + remaining[i] >= best) return;
+    if (i == route.size() - 1) {
+        best = cost;
+        return;
+    }
+    const int from = route[i];
+    const int to = route[i + 1];
+    const double edge = instance.distances(from, to);
+    if (range + edge <= instance.maxDis) enumerate(route, i + 1, range + edge, cost + edge, remaining, maxStationsPerEdge, instance, best);
+    for (int s : instance.stations) {
+        const double toStation = instance.distances(from, s);
+        if (range + toStation > instance.maxDis) continue;
+        const double fromStation = instance.distances(s, to);
+        if (fromStation <= instance.maxDis) {
+            enumerate(route, i + 1, fromStation, cost + toStation + fromStation, remaining, maxStationsPerEdge, instance, best);
+        }
+        if (maxStationsPerEdge < 2) continue;
+        for (int s2 : instance.stations) {
+            const double between = instance.distances(s, s2);
+            const double fromChain = instance.distances(s2, to);
+            if (s2 == s || between > instance.maxDis || fromChain > instance.maxDis) continue;
+            enumerate(route, i + 1, fromChain, cost + toStation + between + fromChain, remaining, maxStationsPerEdge, instance, best);
+        }
+    }
+}
+
+static double brute_force(const vector<int>& route, int maxStationsPerEdge, const Case& instance) {
+    vector<double> remaining(route.size(), 0.0);
+    for (int i = static_cast<int>(route.size()) - 2; i >= 0; i--) remaining[i] = remaining[i + 1] + instance.distances(route[i], route[i + 1]);
+    double best = DBL_MAX;
+    enumerate(route, 0, 0.0, 0.0, remaining, maxStationsPerEdge, instance, best);
+    return best == DBL_MAX ? -1 : best;
+}
+
+static void check_repaired(const vector<int>& repaired, const vector<int>& route, double cost, int maxStationsPerEdge, const Case& instance) {
+    CHECK(repaired.front() == route.front() && repaired.back() == route.back());
+    vector<int> customers;
+    double length = 0;
+    double range = 0;
+    int stationsInARow = 0;
+    for (size_t i = 0; i < repaired.size(); ++i) {
+        if (i > 0) {
+            const double edge = instance.distances(repaired[i - 1], repaired[i]);
+            length += edge;
+            range += edge;
+            CHECK(range <= instance.maxDis);
+        }
+        const bool station = instance.is_charging_station(repaired[i]) && repaired[i] != instance.depot;
+        stationsInARow = station ? stationsInARow + 1 : 0;
+        CHECK(stationsInARow <= maxStationsPerEdge);
+        if (instance.is_charging_station(repaired[i])) range = 0;
+        if (!station) customers.push_back(repaired[i]);
+    }
+    CHECK(customers == route);
+    CHECK(fabs(length - cost) <= 1e-9 * cost);
+}
+
+// a copy of an instance with another battery, in the temporary directory
+static string with_energy_capacity(const string& name, int energyCapacity) {
+    ifstream in(data_file(name + ".evrp"));
+    ostringstream out;
+    string line;
+    while (getline(in, line)) {
+        out << (line.rfind("ENERGY_CAPACITY:", 0) == 0 ? "ENERGY_CAPACITY: " + to_string(energyCapacity) : line) << "\n";
+    }
+    const string path = (filesystem::temp_directory_path() / (name + "-energy-" + to_string(energyCapacity) + ".evrp")).string();
+    ofstream(path) << out.str();
+    return path;
+}
+
+int main() {
+    // the batteries of the E instances reach a station from every customer, the last one has routes without any plan
+    const string shortRange = with_energy_capacity("E-n22-k4", 40);
+    for (const string& file : {data_file("E-n22-k4.evrp"), data_file("E-n23-k3.evrp"), data_file("E-n51-k5.evrp"), data_file("E-n101-k8.evrp"), shortRange}) {
+        auto instance = make_shared<const Case>(file, DistanceStorage::FULL_DOUBLE, false);
+        const string& name = instance->instanceName;
+        Evaluator evaluator(instance);
+        std::default_random_engine rng(1);
+        uniform_int_distribution<int> customerNum(1, 6);
+        int repaired = 0, infeasible = 0;
+        for (int k = 0; k < 300; ++k) {
+            vector<int> customers = instance->customers;
+            shuffle(customers.begin(), customers.end(), rng);
+            vector<int> route(1, instance->depot);
+            route.insert(route.end(), customers.begin(), customers.begin() + customerNum(rng));
+            route.push_back(instance->depot);
+
+            for (int maxStationsPerEdge : {1, 2}) {
+                vector<int> tour;
+                const double cost = insert_station_by_labeling(route.data(), static_cast<int>(route.size()), *instance, evaluator, tour, maxStationsPerEdge);
+                const double expected = brute_force(route, maxStationsPerEdge, *instance);
+                if (expected < 0) {
+                    CHECK(cost == -1);
+                    infeasible++;
+                    continue;
+                }
+                CHECK(fabs(cost - expected) <= 1e-9 * expected);
+                check_repaired(tour, route, cost, maxStationsPerEdge, *instance);
+                repaired += tour.size() > route.size();
+            }
+        }
+        cout << name << ": 600 repairs as the enumeration, " << repaired << " with stations, " << infeasible << " without any plan" << endl;
+    }
+    filesystem::remove(shortRange);
+    return 0;
+}
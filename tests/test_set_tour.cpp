@@ -0,0 +1,58 @@
+// The repaired tour of an individual is sized to the solution: on the largest instance it must hold every route and
+// its stations, and a later repair that fits must reuse the same buffer.
+
+#include <random>
+
+#include "test_utils.hpp"
+#include "../include/case.hpp"
+#include "../include/evaluator.hpp"
+#include "../include/individual.hpp"
+#include "../include/utils.hpp"
+
+using namespace std;
+
+int main() {
+    auto instance = make_shared<const Case>(data_file("X-n1001-k43.evrp"), DistanceStorage::FULL_DOUBLE, false);
+    Evaluator evaluator(instance);
+    std::default_random_engine rng(1);
+    const int routeCap = instance->vehicleNumber * 3;
+
+    vector<vector<int>> routes = routes_constructor_with_split(*instance, evaluator, rng);
+    Individual individual(routeCap, instance->maxRouteLength, routes, evaluator.fitness_evaluation(routes), instance->compute_demand_sum(routes));
+    double fit = fix_one_solution(individual, *instance, evaluator);
+    CHECK(fit < INFEASIBLE);
+
+    // depot, every route without its returning depot, final depot: customers, stations and one depot per route
+    auto [tour, steps] = individual.get_tour();
+    int customers = 0;
+    int stations = 0;
+    for (int i = 0; i < steps; ++i) {
+        if (instance->is_charging_station(tour[i])) {
+            stations += tour[i] != instance->depot;
+        } else {
+            customers++;
+        }
+    }
+    CHECK(customers == instance->customerNumber);
+    CHECK(steps == customers + stations + individual.route_num + 1);
+    CHECK(tour[0] == instance->depot && tour[steps - 1] == instance->depot);
+    CHECK(static_cast<int>(individual.tour.size()) >= steps);
+
+    // a repair of a solution that fits in the current tour must not reallocate it
+    const int* buffer = individual.tour.data();
+    const size_t capacity = individual.tour.capacity();
+    vector<vector<int>> shorter = individual.get_routes();
+    shorter.pop_back();
+    individual.set_tour(shorter);
+    CHECK(individual.tour.data() == buffer);
+    CHECK(individual.tour.capacity() == capacity);
+    CHECK(individual.steps < steps);
+
+    individual.assign(routes, evaluator.fitness_evaluation(routes), instance->compute_demand_sum(routes));
+    CHECK(fix_one_solution(individual, *instance, evaluator) == fit);
+    CHECK(individual.tour.data() == buffer);
+    CHECK(individual.get_tour().second == steps);
+
+    cout << "X-n1001-k43: tour of " << steps << " nodes, " << stations << " stations" << endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+// LINEAR, the default decoder of the MA, must split a giant tour as the O(n^2) split of Prins does: on random giant
+// tours of a few instances both give the same cost and the same routes. LINEAR_SOFT with a penalty larger than any
+// tour never overloads a route and so gives the LINEAR split as well.
+// ENERGY leaves the recharging plan of every route it decodes in the repair cache: a feasible plan with the cost of
+// insert_station_by_labeling, charged as that repair.
+
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include "test_utils.hpp"
+#include "../include/case.hpp"
+#include "../include/evaluator.hpp"
+#include "../include/individual.hpp"
+#include "../include/repair_cache.hpp"
+#include "../include/utils.hpp"
+
+using namespace std;
+
+// the routes in giant tour order, whatever order the split returns them in
+static vector<vector<int>> in_tour_order(vector<vector<int>> routes, const vector<int>& x) {
+    vector<int> position(x.size() + 1);
+    for (int i = 1; i < static_cast<int>(x.size()); ++i) position[x[i]] = i;
+    sort(routes.begin(), routes.end(), [&](const vector<int>& a, const vector<int>& b) { return position[a[0]] < position[b[0]]; });
+    return routes;
+}
+
+static int route_load(const vector<int>& route, const Case& instance) {
+    int load = 0;
+    for (int node : route) load += instance.get_customer_demand(node);
+    return load;
+}
+
+static double split_cost(const vector<vector<int>>& routes, const Case& instance) {
+    double cost = 0;
+    for (const auto& route : routes) {
+        cost += instance.distances(instance.depot, route.front()) + instance.distances(route.back(), instance.depot);
+        for (size_t i = 1; i < route.size(); ++i) cost += instance.distances(route[i - 1], route[i]);
+    }
+    return cost;
+}
+
+static void check_split(const vector<vector<int>>& routes, const vector<vector<int>>& expected, const vector<int>& x, const Case& instance) {
+    vector<int> customers(1, instance.depot);
+    for (const auto& route : routes) {
+        CHECK(!route.empty());
+        CHECK(route_load(route, instance) <= instance.maxC);
+        customers.insert(customers.end(), route.begin(), route.end());
+    }
+    CHECK(customers == x);
+    const double cost = split_cost(routes, instance);
+    const double expectedCost = split_cost(expected, instance);
+    CHECK(fabs(cost - expectedCost) <= 1e-9 * expectedCost);
+    CHECK(routes.size() == expected.size());
+    for (size_t i = 0; i < routes.size(); ++i) {
+        CHECK(route_load(routes[i], instance) == route_load(expected[i], instance));
+    }
+}
+
+// the plan keeps the customers of the route in order and never drives more than maxDis between two recharges
+static void check_plan(const vector<int>& plan, const int* route, int length, double cost, const Case& instance) {
+    CHECK(plan.front() == instance.depot && plan.back() == instance.depot);
+    vector<int> customers;
+    double distance = 0, range = 0;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        if (i > 0) {
+            distance += instance.distances(plan[i - 1], plan[i]);
+            range += instance.distances(plan[i - 1], plan[i]);
+            CHECK(range <= instance.maxDis);
+        }
+        if (instance.is_charging_station(plan[i])) range = 0;
+        if (!instance.is_charging_station(plan[i]) || plan[i] == instance.depot) customers.push_back(plan[i]);
+    }
+    CHECK(customers == vector<int>(route, route + length));
+    CHECK(fabs(distance - cost) <= 1e-9 * cost);
+}
+
+static void check_energy_plans(const shared_ptr<const Case>& instance) {
+    Evaluator evaluator(instance);
+    RepairCache cache;
+    Individual individual(instance->vehicleNumber * 3, instance->maxRouteLength);
+    std::default_random_engine rng(1);
+    int routes = 0;
+    for (int k = 0; k < 5; ++k) {
+        vector<int> x(1, instance->depot);
+        x.insert(x.end(), instance->customers.begin(), instance->customers.end());
+        shuffle(x.begin() + 1, x.end(), rng);
+        decode_giant_tour(SplitMethod::ENERGY, x, *instance, evaluator, individual, &cache);
+        for (int r = 0; r < individual.route_num; ++r, ++routes) {
+            pair<double, vector<int>> cached;
+            double cachedEvals;
+            CHECK(cache.find(individual.routes[r], individual.node_num[r], cached, cachedEvals));
+            const double evals = evaluator.get_evals();
+            pair<double, vector<int>> repaired = insert_station_by_labeling(individual.routes[r], individual.node_num[r], *instance, evaluator);
+            CHECK(repaired.first != -1);
+            CHECK(fabs(cached.first - repaired.first) <= 1e-9 * repaired.first);
+            CHECK(fabs(cachedEvals - (evaluator.get_evals() - evals)) <= 1e-9 * cachedEvals);
+            check_plan(cached.second, individual.routes[r], individual.node_num[r], cached.first, *instance);
+        }
+    }
+    cout << instance->instanceName << ": the " << routes << " routes of ENERGY have their recharging plans in the cache" << endl;
+}
+
+int main() {
+    for (const string name : {"E-n22-k4", "E-n51-k5", "E-n101-k8", "X-n214-k11", "X-n1001-k43"}) {
+        auto instance = make_shared<const Case>(data_file(name + ".evrp"), DistanceStorage::FULL_DOUBLE, false);
+        Evaluator evaluator(instance);
+        std::default_random_engine rng(1);
+        for (int k = 0; k < 20; ++k) {
+            vector<int> customers = instance->customers;
+            shuffle(customers.begin(), customers.end(), rng);
+            vector<int> x(1, instance->depot);
+            x.insert(x.end(), customers.begin(), customers.end());
+
+            vector<vector<int>> expected = in_tour_order(prins_split(x, *instance, evaluator), x);
+            check_split(in_tour_order(linear_split(x, *instance, evaluator), x), expected, x, *instance);
+            check_split(in_tour_order(linear_split_soft(x, *instance, evaluator, 1e12), x), expected, x, *instance);
+        }
+        cout << name << ": LINEAR and LINEAR_SOFT agree with the split of Prins on 20 giant tours" << endl;
+        check_energy_plans(instance);
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef CEVRP_YINGHAO_TEST_UTILS_HPP
+#define CEVRP_YINGHAO_TEST_UTILS_HPP
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+
+// The tests are plain executables registered with ctest: a failed check prints its location and exits with 1.
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(1); \
+        } \
+    } while (0)
+
+// the instances of the repository, CEVRP_DATA_DIR is set by CMake
+inline std::string data_file(const std::string& name) {
+    return std::string(CEVRP_DATA_DIR) + name;
+}
+
+
+#endif //CEVRP_YINGHAO_TEST_UTILS_HPP